@@ -0,0 +1,1049 @@
+// Benchmarks for md2html.
+//
+// Build and run:
+//   g++ -std=c++17 -O2 -pthread -o md2html_bench bench.cpp
+//   ./md2html_bench                      human-readable table
+//   ./md2html_bench --json > run.json    machine-readable, for tracking regressions
+//   ./md2html_bench --sizes 1K,1M,1G     document sizes for the corpus benchmarks
+//   ./md2html_bench --time 0.2           minimum seconds per benchmark
+//   ./md2html_bench --corpus dir         write the synthetic corpus to dir and exit
+
+// Counted through main.cpp's operator new, so every result reports
+// allocations per line alongside its throughput
+#define MD2HTML_NO_MAIN
+#define MD2HTML_COUNT_ALLOCATIONS
+#include "main.cpp"
+
+#include <chrono>
+#include <iomanip>
+#include <regex>
+
+// Gives the benchmarks access to DocumentContext internals.
+struct ConverterBench
+{
+    static string inlineFormatting(DocumentContext &converter, const string &line)
+    {
+        return converter.processInlineFormatting(line);
+    }
+
+    static string escapeHtml(DocumentContext &converter, const string &text)
+    {
+        return converter.escapeHtml(text);
+    }
+
+    static string generateId(DocumentContext &converter, const string &heading)
+    {
+        return converter.generateId(heading);
+    }
+
+    static size_t parseTableRow(DocumentContext &converter, const string &line)
+    {
+        return converter.parseTableRow(line).size();
+    }
+
+    // Builds the document tree only; returns the arena bytes it took.
+    static size_t parse(DocumentContext &converter, const string &markdown)
+    {
+        converter.beginDocument();
+        DocumentLines source(markdown);
+        converter.parseLines(source, nullptr);
+        return converter.arena.bytesUsed();
+    }
+
+    // Renders the tree left by the last parse().
+    static string render(DocumentContext &converter)
+    {
+        string html;
+        converter.renderer.renderBlocks(converter.document.first, html);
+        return html;
+    }
+};
+
+// The regex chain processInlineFormatting used before the single-pass
+// scanner, kept here as the baseline to measure against.
+namespace legacy
+{
+    string escapeHtml(const string &text)
+    {
+        string escaped = text;
+        size_t pos = 0;
+        while ((pos = escaped.find("&", pos)) != string::npos)
+        {
+            escaped.replace(pos, 1, "&amp;");
+            pos += 5;
+        }
+        pos = 0;
+        while ((pos = escaped.find("<", pos)) != string::npos)
+        {
+            escaped.replace(pos, 1, "&lt;");
+            pos += 4;
+        }
+        pos = 0;
+        while ((pos = escaped.find(">", pos)) != string::npos)
+        {
+            escaped.replace(pos, 1, "&gt;");
+            pos += 4;
+        }
+        return escaped;
+    }
+
+    string processEmojis(string text)
+    {
+        static const map<string, string> emojiMap = {
+            {":smile:", "😊"}, {":heart:", "❤️"}, {":thumbsup:", "👍"}, {":thumbsdown:", "👎"},
+            {":fire:", "🔥"}, {":star:", "⭐"}, {":rocket:", "🚀"}, {":tada:", "🎉"},
+            {":eyes:", "👀"}, {":laugh:", "😂"}, {":cry:", "😢"}, {":angry:", "😠"},
+            {":cool:", "😎"}, {":wink:", "😉"}, {":thinking:", "🤔"}, {":check:", "✅"},
+            {":x:", "❌"}, {":warning:", "⚠️"}, {":info:", "ℹ️"}, {":bulb:", "💡"}};
+        for (const auto &emoji : emojiMap)
+        {
+            size_t pos = 0;
+            while ((pos = text.find(emoji.first, pos)) != string::npos)
+            {
+                text.replace(pos, emoji.first.length(), emoji.second);
+                pos += emoji.second.length();
+            }
+        }
+        return text;
+    }
+
+    string processInlineFormatting(string line)
+    {
+        line = escapeHtml(line);
+        line = processEmojis(line);
+        line = regex_replace(line, regex("\\$\\$([^$]+)\\$\\$"), "<div class=\"math-block\">$1</div>");
+        line = regex_replace(line, regex("\\$([^$]+)\\$"), "<span class=\"math-inline\">$1</span>");
+        line = regex_replace(line, regex("\\[\\^([^\\]]+)\\]"), "<sup><a href=\"#fn$1\" id=\"fnref$1\">$1</a></sup>");
+        line = regex_replace(line, regex("`([^`]+)`"), "<code>$1</code>");
+        line = regex_replace(line, regex("!\\[([^\\]]*)\\]\\(([^)]+)\\)"), "<img src=\"$2\" alt=\"$1\">");
+        line = regex_replace(line, regex("\\[([^\\]]+)\\]\\(([^)]+)\\)"), "<a href=\"$2\">$1</a>");
+        line = regex_replace(line, regex(R"((https?://[^\s)]+))"), "<a href=\"$1\">$1</a>");
+        line = regex_replace(line, regex("\\*\\*([^*]+)\\*\\*"), "<strong>$1</strong>");
+        line = regex_replace(line, regex("__([^_]+)__"), "<strong>$1</strong>");
+        line = regex_replace(line, regex("\\*([^*]+)\\*"), "<em>$1</em>");
+        line = regex_replace(line, regex("_([^_]+)_"), "<em>$1</em>");
+        line = regex_replace(line, regex("~~([^~]+)~~"), "<del>$1</del>");
+        return line;
+    }
+}
+
+// Deterministic lines of prose mixed with inline markup.
+vector<string> generateInlineLines(size_t count)
+{
+    static const char *fragments[] = {
+        "The quick brown fox jumps over the lazy dog.",
+        "This has **bold text** and *italic text* in it.",
+        "Call `parse(input)` before rendering & check x < y.",
+        "See [the docs](https://example.com/docs) for details.",
+        "Raw link https://example.org/page and an image ![logo](logo.png).",
+        "Some __strong__ words, some _emphasis_ and ~~removed~~ text.",
+        "Inline math $a^2 + b^2 = c^2$ next to a footnote[^1].",
+        "Shipping it :rocket: :tada: after review :thumbsup:.",
+    };
+    const size_t fragmentCount = sizeof(fragments) / sizeof(fragments[0]);
+
+    vector<string> lines;
+    lines.reserve(count);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < count; i++)
+    {
+        string line;
+        for (int f = 0; f < 4; f++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            if (!line.empty())
+                line += ' ';
+            line += fragments[(seed >> 16) % fragmentCount];
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// Keeps results observable so the optimizer cannot drop the work.
+static volatile size_t benchSink;
+
+static size_t resultSize(const string &result) { return result.length(); }
+static size_t resultSize(size_t result) { return result; }
+
+// Deterministic lines of prose with shortcodes, a few of them unknown.
+vector<string> generateEmojiLines(size_t count)
+{
+    static const char *fragments[] = {
+        "Shipping it :rocket: :tada: after review :+1:.",
+        "Build is green :white_check_mark: but docs are late :hourglass_flowing_sand:.",
+        "Pairing with :man_technologist: and :woman_technologist: at 10:30 today.",
+        "Unknown codes like :not_an_emoji: and :foo: stay as they are.",
+        "Flags :jp: :de: :brazil: and hearts :heart: :purple_heart:.",
+    };
+    const size_t fragmentCount = sizeof(fragments) / sizeof(fragments[0]);
+
+    vector<string> lines;
+    lines.reserve(count);
+    uint32_t seed = 4242;
+    for (size_t i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        lines.push_back(fragments[(seed >> 16) % fragmentCount]);
+    }
+    return lines;
+}
+
+// What processEmojis would cost with the full shortcode set: one find() pass
+// over the line for every known shortcode.
+string findLoopEmojis(string text)
+{
+    static const vector<pair<string, string>> shortcodes = []
+    {
+        vector<pair<string, string>> list;
+        for (const EmojiEntry &entry : emojiEntries)
+            list.emplace_back(string(":") + entry.name + ":", entry.emoji);
+        return list;
+    }();
+    for (const auto &emoji : shortcodes)
+    {
+        size_t pos = 0;
+        while ((pos = text.find(emoji.first, pos)) != string::npos)
+        {
+            text.replace(pos, emoji.first.length(), emoji.second);
+            pos += emoji.second.length();
+        }
+    }
+    return text;
+}
+
+// Deterministic lines of C++ and shell code, as found in fenced code blocks.
+vector<string> generateCodeLines(size_t count)
+{
+    static const char *fragments[] = {
+        "    for (size_t i = 0; i < items.size() && !done; i++)",
+        "    if (a < b && b > c) { return \"<tag attr=\\\"x\\\">\"; }",
+        "template <typename T> std::vector<std::pair<T, T>> zip(const T &a, const T &b);",
+        "    std::cout << \"value: \" << value << std::endl;",
+        "cat input.md | ./md2html - - > out.html 2>&1 && echo done",
+        "    // Plain comment line without anything that needs escaping at all",
+    };
+    const size_t fragmentCount = sizeof(fragments) / sizeof(fragments[0]);
+
+    vector<string> lines;
+    lines.reserve(count);
+    uint32_t seed = 999;
+    for (size_t i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        lines.push_back(fragments[(seed >> 16) % fragmentCount]);
+    }
+    return lines;
+}
+
+// Deterministic table of rows, mostly plain cells as in exported data, with
+// aligned columns and the odd formatted or escaped cell.
+string generateTableDocument(size_t rows)
+{
+    static const char *cells[] = {"alpha", "1024", "ok", "2024-01-31", "north region", "0.75",
+                                  "**bold**", "`a \\| b`", "n/a", "beta", "42", "x \\| y"};
+    const size_t cellCount = sizeof(cells) / sizeof(cells[0]);
+
+    string doc = "| Name | Count | Status | Date | Region | Ratio |\n|:-----|------:|:------:|------|------|-----:|\n";
+    uint32_t seed = 24680;
+    for (size_t r = 0; r < rows; r++)
+    {
+        doc += '|';
+        for (int c = 0; c < 6; c++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            doc += ' ';
+            doc += cells[(seed >> 16) % cellCount];
+            doc += " |";
+        }
+        doc += '\n';
+    }
+    return doc;
+}
+
+// A fence of about bytes of code in language, repeating a short sample
+// that uses each kind of token the highlighter knows for it. An empty
+// language gives the C++ sample in a fence without one.
+string generateCodeBlock(const string &language, size_t bytes)
+{
+    static const pair<const char *, const char *> samples[] = {
+        {"cpp", "#include <vector>\n/* Sum of the values\n   in order */\nstatic int64_t sum(const std::vector<int> &v) {\n"
+                "    int64_t total = 0; // running total\n    for (size_t i = 0; i < v.size(); i++) total += v[i] * 0x1F;\n"
+                "    return total > 1.5e3 ? total : -1; }\nconst char *name = \"value <\\\"x\\\">\";\n"},
+        {"python", "@cached\ndef fib(n: int) -> int:\n    \"\"\"Fibonacci number\n    of n.\"\"\"\n"
+                   "    if n < 2 or n is None:  # base case\n        return n\n    return fib(n - 1) + fib(n - 2) * 1.5\n"
+                   "print(f'{fib(10)}', True, [x for x in range(3)])\n"},
+        {"javascript", "import { render } from './view.js';\nconst items = [1, 2.5, null, undefined];\n"
+                       "async function load(url) { // fetch and parse\n  const $res = await fetch(`${url}?page=1\n&all=true`);\n"
+                       "  return typeof $res === 'object' ? $res.json() : false; }\n/* done */ export default load;\n"},
+        {"bash", "#!/bin/bash\nset -euo pipefail\nfor f in \"$SRC\"/*.md; do  # each page\n"
+                 "  out=\"${f%.md}.html\"\n  if [ -f \"$out\" ]; then echo \"skip $out\"; continue; fi\n"
+                 "  ./md2html -j 4 \"$f\" \"$out\" || exit 1\ndone\n"},
+        {"json", "{\"name\": \"md2html\", \"version\": 1.3, \"tags\": [\"markdown\", \"html\"],\n"
+                 " \"limits\": {\"nesting\": 32, \"columns\": 256, \"strict\": true, \"theme\": null}}\n"},
+        {"yaml", "---\njobs:\n  build:  # main job\n    runs-on: ubuntu-latest\n    steps:\n"
+                 "      - name: \"Build\"\n        run: make -j 4\n      - cache: true\n        retries: 3\n"},
+        {"sql", "SELECT u.id, COUNT(*) AS pages -- per user\nFROM users u LEFT JOIN pages p ON p.owner = u.id\n"
+                "WHERE u.created > '2024-01-01' AND p.size >= 1024\n/* largest first */ GROUP BY u.id ORDER BY pages DESC LIMIT 10;\n"},
+    };
+
+    string sample = samples[0].second;
+    for (const auto &entry : samples)
+    {
+        if (language == entry.first)
+            sample = entry.second;
+    }
+    string doc = "```" + language + "\n";
+    while (doc.length() < bytes)
+        doc += sample;
+    doc += "```\n";
+    return doc;
+}
+
+// Deterministic document of plain paragraphs, the common case in our corpus.
+string generateProseDocument(size_t paragraphs)
+{
+    static const char *words[] = {"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+                                  "markdown", "converter", "renders", "plain", "prose", "quickly"};
+    const size_t wordCount = sizeof(words) / sizeof(words[0]);
+
+    string doc;
+    uint32_t seed = 54321;
+    for (size_t p = 0; p < paragraphs; p++)
+    {
+        for (int line = 0; line < 4; line++)
+        {
+            for (int w = 0; w < 12; w++)
+            {
+                seed = seed * 1103515245u + 12345u;
+                if (w > 0)
+                    doc += ' ';
+                doc += words[(seed >> 16) % wordCount];
+            }
+            doc += ".\n";
+        }
+        doc += '\n';
+    }
+    return doc;
+}
+
+// Scans line for :shortcodes: the way the inline scanner does, replacing the
+// known ones; the emoji path of processInlineFormatting on its own.
+string processEmojis(const string &line)
+{
+    string out;
+    out.reserve(line.length());
+    size_t n = line.length();
+    for (size_t i = 0; i < n; i++)
+    {
+        if (line[i] == ':')
+        {
+            size_t end = i + 1;
+            while (end < n && (isalnum(static_cast<unsigned char>(line[end])) || line[end] == '_' || line[end] == '+' || line[end] == '-'))
+                end++;
+            if (end < n && end > i + 1 && line[end] == ':')
+            {
+                if (const char *emoji = lookupEmoji(line.data() + i + 1, end - i - 1))
+                {
+                    out += emoji;
+                    i = end;
+                    continue;
+                }
+            }
+        }
+        out += line[i];
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Synthetic corpus
+//
+// Documents of one flavour each, built block by block from a fixed seed so
+// every run and every machine sees the same bytes. A document of a given
+// size is always a prefix of the larger ones.
+// ---------------------------------------------------------------------------
+
+enum class CorpusKind
+{
+    Prose,
+    Tables,
+    Lists,
+    Code,
+    Inline,
+    EmojiMath
+};
+
+static const CorpusKind corpusKinds[] = {CorpusKind::Prose, CorpusKind::Tables, CorpusKind::Lists,
+                                         CorpusKind::Code, CorpusKind::Inline, CorpusKind::EmojiMath};
+
+static const char *corpusName(CorpusKind kind)
+{
+    switch (kind)
+    {
+    case CorpusKind::Prose:
+        return "prose";
+    case CorpusKind::Tables:
+        return "tables";
+    case CorpusKind::Lists:
+        return "lists";
+    case CorpusKind::Code:
+        return "code";
+    case CorpusKind::Inline:
+        return "inline";
+    case CorpusKind::EmojiMath:
+        return "emoji-math";
+    }
+    return "";
+}
+
+class CorpusGenerator
+{
+private:
+    CorpusKind kind;
+    uint32_t seed;
+    size_t blocks = 0;
+
+    uint32_t next(uint32_t range)
+    {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) % range;
+    }
+
+    template <size_t N>
+    const char *pick(const char *const (&choices)[N])
+    {
+        return choices[next(N)];
+    }
+
+    void words(string &out, size_t count)
+    {
+        static const char *const vocabulary[] = {"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+                                                 "markdown", "converter", "renders", "plain", "prose", "quickly",
+                                                 "table", "list", "block", "inline", "stream", "buffer"};
+        for (size_t w = 0; w < count; w++)
+        {
+            if (w > 0)
+                out += ' ';
+            out += pick(vocabulary);
+        }
+    }
+
+    void prose(string &out)
+    {
+        if (blocks % 8 == 0)
+        {
+            out += string(1 + next(3), '#') + " Section " + to_string(blocks) + "\n\n";
+        }
+        for (uint32_t line = 0, lines = 3 + next(4); line < lines; line++)
+        {
+            words(out, 10 + next(6));
+            out += ".\n";
+        }
+    }
+
+    void table(string &out)
+    {
+        uint32_t columns = 3 + next(4);
+        out += '|';
+        for (uint32_t c = 0; c < columns; c++)
+            out += " Column " + to_string(c) + " |";
+        out += "\n|";
+        for (uint32_t c = 0; c < columns; c++)
+            out += c % 2 == 0 ? "---|" : ":---:|";
+        out += '\n';
+        for (uint32_t row = 0, rows = 10 + next(20); row < rows; row++)
+        {
+            out += '|';
+            for (uint32_t c = 0; c < columns; c++)
+            {
+                out += ' ';
+                switch (next(4))
+                {
+                case 0:
+                    out += to_string(next(100000));
+                    break;
+                case 1:
+                    out += "`value_" + to_string(next(100)) + "`";
+                    break;
+                default:
+                    words(out, 1 + next(3));
+                }
+                out += " |";
+            }
+            out += '\n';
+        }
+    }
+
+    void list(string &out)
+    {
+        bool ordered = next(3) == 0;
+        for (uint32_t item = 0, items = 4 + next(8); item < items; item++)
+        {
+            uint32_t depth = item == 0 ? 0 : next(3);
+            out += string(depth * 2, ' ');
+            out += ordered && depth == 0 ? to_string(item + 1) + ". " : "- ";
+            if (next(4) == 0)
+                out += next(2) == 0 ? "[x] " : "[ ] ";
+            words(out, 3 + next(8));
+            out += '\n';
+        }
+    }
+
+    void code(string &out)
+    {
+        static const char *const languages[] = {"cpp", "python", "bash"};
+        static const char *const lines[] = {
+            "for (size_t i = 0; i < items.size() && !done; i++)",
+            "if (a < b && b > c) { return \"<tag attr=\\\"x\\\">\"; }",
+            "template <typename T> std::vector<std::pair<T, T>> zip(const T &a, const T &b);",
+            "def render(node, out): return ''.join(child.html() for child in node)",
+            "cat input.md | ./md2html - - > out.html 2>&1 && echo done",
+            "// Plain comment line without anything that needs escaping at all",
+        };
+        words(out, 8);
+        out += ":\n\n```";
+        out += pick(languages);
+        out += '\n';
+        for (uint32_t line = 0, count = 5 + next(20); line < count; line++)
+        {
+            out += string(4 * next(3), ' ');
+            out += pick(lines);
+            out += '\n';
+        }
+        out += "```\n";
+    }
+
+    void inlineMarkup(string &out)
+    {
+        static const char *const fragments[] = {
+            "This has **bold text** and *italic text* in it.",
+            "Call `parse(input)` before rendering & check x < y.",
+            "See [the docs](https://example.com/docs) for details.",
+            "Raw link https://example.org/page and an image ![logo](logo.png).",
+            "Some __strong__ words, some _emphasis_ and ~~removed~~ text.",
+            "Nested **bold with *italic* inside** and a footnote[^1].",
+        };
+        for (uint32_t line = 0, lines = 2 + next(4); line < lines; line++)
+        {
+            for (int f = 0; f < 3; f++)
+            {
+                if (f > 0)
+                    out += ' ';
+                out += pick(fragments);
+            }
+            out += '\n';
+        }
+    }
+
+    void emojiMath(string &out)
+    {
+        static const char *const fragments[] = {
+            "Shipping it :rocket: :tada: after review :+1:.",
+            "Flags :jp: :de: :brazil: and hearts :heart: :purple_heart:.",
+            "Unknown codes like :not_an_emoji: stay as they are.",
+            "Inline math $a^2 + b^2 = c^2$ and $\\sum_{i=1}^{n} i$ in prose.",
+            "Euler wrote $e^{i\\pi} + 1 = 0$ :sparkles: once.",
+        };
+        if (next(4) == 0)
+        {
+            out += "$$\n\\int_0^\\infty e^{-x^2} dx = \\frac{\\sqrt{\\pi}}{2}\n$$\n";
+            return;
+        }
+        for (uint32_t line = 0, lines = 2 + next(3); line < lines; line++)
+        {
+            out += pick(fragments);
+            out += ' ';
+            out += pick(fragments);
+            out += '\n';
+        }
+    }
+
+public:
+    explicit CorpusGenerator(CorpusKind corpusKind)
+        : kind(corpusKind), seed(1000 + static_cast<uint32_t>(corpusKind)) {}
+
+    // Appends one block followed by a blank line.
+    void block(string &out)
+    {
+        switch (kind)
+        {
+        case CorpusKind::Prose:
+            prose(out);
+            break;
+        case CorpusKind::Tables:
+            if (blocks % 2 == 0)
+                prose(out);
+            else
+                table(out);
+            break;
+        case CorpusKind::Lists:
+            list(out);
+            break;
+        case CorpusKind::Code:
+            code(out);
+            break;
+        case CorpusKind::Inline:
+            inlineMarkup(out);
+            break;
+        case CorpusKind::EmojiMath:
+            emojiMath(out);
+            break;
+        }
+        out += '\n';
+        blocks++;
+    }
+};
+
+string generateCorpusDocument(CorpusKind kind, size_t bytes)
+{
+    CorpusGenerator generator(kind);
+    string doc;
+    doc.reserve(bytes + 4096);
+    while (doc.length() < bytes)
+        generator.block(doc);
+    return doc;
+}
+
+// Writes one document of each kind and size to directory, in 1 MB pieces so
+// gigabyte documents need no more memory than a small one.
+bool writeCorpus(const fs::path &directory, const vector<size_t> &sizes)
+{
+    error_code ec;
+    fs::create_directories(directory, ec);
+    for (CorpusKind kind : corpusKinds)
+    {
+        for (size_t size : sizes)
+        {
+            fs::path file = directory / (string(corpusName(kind)) + "-" + to_string(size) + ".md");
+            ofstream out(file, ios::binary);
+            if (!out.is_open())
+            {
+                cerr << "Error: Cannot create '" << file.string() << "'.\n";
+                return false;
+            }
+            CorpusGenerator generator(kind);
+            string chunk;
+            size_t written = 0;
+            while (written < size)
+            {
+                chunk.clear();
+                while (chunk.length() < (1 << 20) && written + chunk.length() < size)
+                    generator.block(chunk);
+                out.write(chunk.data(), static_cast<streamsize>(chunk.length()));
+                written += chunk.length();
+            }
+            cout << file.string() << " (" << written << " bytes)\n";
+        }
+    }
+    return true;
+}
+
+// "64K", "1M", "1G" or a plain byte count.
+static size_t parseSize(const string &text)
+{
+    size_t value = strtoull(text.c_str(), nullptr, 10);
+    switch (text.empty() ? '\0' : toupper(static_cast<unsigned char>(text.back())))
+    {
+    case 'K':
+        return value << 10;
+    case 'M':
+        return value << 20;
+    case 'G':
+        return value << 30;
+    default:
+        return value;
+    }
+}
+
+static string formatSize(size_t bytes)
+{
+    if (bytes >= (1u << 30) && bytes % (1u << 30) == 0)
+        return to_string(bytes >> 30) + " GB";
+    if (bytes >= (1u << 20) && bytes % (1u << 20) == 0)
+        return to_string(bytes >> 20) + " MB";
+    if (bytes >= (1u << 10) && bytes % (1u << 10) == 0)
+        return to_string(bytes >> 10) + " KB";
+    return to_string(bytes) + " B";
+}
+
+// Input written to be slow: unmatched brackets and delimiters, code spans
+// that never close, emphasis and lists nested without end. Each pattern
+// grows to the wanted size; conversion time should grow with it linearly.
+struct AdversarialPattern
+{
+    const char *name;
+    string (*generate)(size_t bytes);
+};
+
+static string repeatTo(const string &unit, size_t bytes)
+{
+    string out;
+    out.reserve(bytes + unit.length());
+    while (out.length() < bytes)
+        out += unit;
+    return out;
+}
+
+static const AdversarialPattern adversarialPatterns[] = {
+    {"unclosed brackets", [](size_t bytes)
+     { return repeatTo("[", bytes); }},
+    {"unclosed images", [](size_t bytes)
+     { return repeatTo("![a", bytes); }},
+    {"unclosed footnotes", [](size_t bytes)
+     { return repeatTo("[^", bytes); }},
+    {"closers only", [](size_t bytes)
+     { return repeatTo("a* ", bytes); }},
+    {"openers then closers", [](size_t bytes)
+     { return repeatTo("*a ", bytes / 2) + repeatTo("b* ", bytes / 2); }},
+    {"one deep run", [](size_t bytes)
+     { return string(bytes / 2, '*') + "a" + string(bytes / 2, '*'); }},
+    {"backtick runs", [](size_t bytes)
+     {
+         string out;
+         for (size_t run = 1; out.length() < bytes; run++)
+             out += string(run, '`') + "a";
+         return out;
+     }},
+    {"punctuation heading", [](size_t bytes)
+     { return "# " + string(bytes, '-'); }},
+    {"deep list", [](size_t bytes)
+     {
+         string out;
+         for (size_t depth = 0; out.length() < bytes; depth++)
+             out += string(2 * depth, ' ') + "- item\n";
+         return out;
+     }},
+    {"wide table", [](size_t bytes)
+     { return "|" + repeatTo("a|", bytes / 3) + "\n|" + repeatTo("-|", bytes / 3) + "\n|" + repeatTo("b|", bytes / 3) + "\n"; }},
+};
+
+// ---------------------------------------------------------------------------
+// Harness
+// ---------------------------------------------------------------------------
+
+struct BenchResult
+{
+    string group;
+    string name;
+    size_t bytes;      // per iteration
+    size_t lines;      // per iteration
+    size_t iterations;
+    double seconds;
+    size_t allocations;
+    double p50;        // seconds per iteration
+    double p99;
+};
+
+static vector<BenchResult> benchResults;
+static string benchGroup;
+static bool jsonOutput = false;
+static double minSeconds = 1.0;
+
+static void beginGroup(const string &title)
+{
+    benchGroup = title;
+    if (!jsonOutput)
+        cout << (benchResults.empty() ? "" : "\n") << title << "\n";
+}
+
+// Each input counts as one line, or as its line count if it is a document.
+static size_t countLines(const vector<string> &inputs)
+{
+    size_t lines = 0;
+    for (const string &input : inputs)
+        lines += max<size_t>(1, static_cast<size_t>(count(input.begin(), input.end(), '\n')));
+    return lines;
+}
+
+static void writeJsonString(ostream &out, const string &text)
+{
+    out << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+static void writeJson(ostream &out)
+{
+    out << "{\n  \"version\": ";
+    writeJsonString(out, converterVersion);
+    out << ",\n  \"results\": [";
+    for (size_t i = 0; i < benchResults.size(); i++)
+    {
+        const BenchResult &r = benchResults[i];
+        double lines = static_cast<double>(r.lines * r.iterations);
+        out << (i == 0 ? "\n" : ",\n") << "    {\"group\": ";
+        writeJsonString(out, r.group);
+        out << ", \"name\": ";
+        writeJsonString(out, r.name);
+        out << fixed << setprecision(3)
+            << ", \"bytes\": " << r.bytes
+            << ", \"lines\": " << r.lines
+            << ", \"iterations\": " << r.iterations
+            << ", \"seconds\": " << r.seconds
+            << ", \"mb_per_s\": " << static_cast<double>(r.bytes * r.iterations) / (1024.0 * 1024.0) / r.seconds
+            << ", \"ns_per_line\": " << r.seconds * 1e9 / lines
+            << ", \"allocs_per_line\": " << static_cast<double>(r.allocations) / lines
+            << ", \"p50_us\": " << r.p50 * 1e6
+            << ", \"p99_us\": " << r.p99 * 1e6 << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+template <typename Fn>
+void runBenchmark(const string &name, const vector<string> &lines, Fn fn)
+{
+    size_t bytes = 0;
+    for (const string &line : lines)
+        bytes += line.length();
+    size_t lineCount = countLines(lines);
+
+    // Reserved up front so recording latencies allocates nothing
+    vector<double> latencies;
+    latencies.reserve(1 << 16);
+
+    using clock = chrono::steady_clock;
+    size_t iterations = 0;
+    size_t allocationsBefore = allocationCounters.count;
+    auto start = clock::now();
+    double elapsed = 0;
+    do
+    {
+        for (const string &line : lines)
+            benchSink = benchSink + resultSize(fn(line));
+        iterations++;
+        double previous = elapsed;
+        elapsed = chrono::duration<double>(clock::now() - start).count();
+        if (latencies.size() < latencies.capacity())
+            latencies.push_back(elapsed - previous);
+    } while (elapsed < minSeconds);
+    size_t allocations = allocationCounters.count - allocationsBefore;
+
+    sort(latencies.begin(), latencies.end());
+    double p50 = latencies[latencies.size() / 2];
+    double p99 = latencies[latencies.size() * 99 / 100];
+    benchResults.push_back({benchGroup, name, bytes, lineCount, iterations, elapsed, allocations, p50, p99});
+    if (jsonOutput)
+        return;
+    double mb = static_cast<double>(bytes * iterations) / (1024.0 * 1024.0);
+    double totalLines = static_cast<double>(lineCount * iterations);
+    cout << left << setw(32) << name << right << fixed << setprecision(2)
+         << setw(10) << mb / elapsed << " MB/s"
+         << setw(12) << elapsed * 1e9 / totalLines << " ns/line"
+         << setw(10) << static_cast<double>(allocations) / totalLines << " allocs/line"
+         << setw(12) << p99 * 1e6 << " us p99\n";
+}
+
+int main(int argc, char *argv[])
+{
+    vector<size_t> sizes = {1 << 10, 64 << 10, 1 << 20};
+    string corpusDir;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--json")
+            jsonOutput = true;
+        else if (arg == "--time" && i + 1 < argc)
+            minSeconds = atof(argv[++i]);
+        else if (arg == "--corpus" && i + 1 < argc)
+            corpusDir = argv[++i];
+        else if (arg == "--sizes" && i + 1 < argc)
+        {
+            sizes.clear();
+            stringstream list(argv[++i]);
+            string size;
+            while (getline(list, size, ','))
+                sizes.push_back(parseSize(size));
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--json] [--time seconds] [--sizes 1K,1M,...] [--corpus dir]\n";
+            return 1;
+        }
+    }
+    if (!corpusDir.empty())
+        return writeCorpus(corpusDir, sizes) ? 0 : 1;
+    allocationCounters.enabled = true;
+
+    DocumentContext converter;
+    vector<string> lines = generateInlineLines(2000);
+
+    beginGroup("processInlineFormatting, " + to_string(lines.size()) + " inline-heavy lines");
+    runBenchmark("regex chain (legacy)", lines, [](const string &line)
+                 { return legacy::processInlineFormatting(line); });
+    runBenchmark("single-pass scanner", lines, [&](const string &line)
+                 { return ConverterBench::inlineFormatting(converter, line); });
+
+    vector<string> emojiLines = generateEmojiLines(2000);
+    beginGroup("emoji shortcodes, " + to_string(emojiLines.size()) + " lines, " + to_string(emojiCount) + " known codes");
+    runBenchmark("find() per shortcode", emojiLines, [](const string &line)
+                 { return findLoopEmojis(line); });
+    runBenchmark("processEmojis (scan only)", emojiLines, [](const string &line)
+                 { return processEmojis(line); });
+    runBenchmark("hash lookup at ':'", emojiLines, [&](const string &line)
+                 { return ConverterBench::inlineFormatting(converter, line); });
+
+    vector<string> code = generateCodeLines(5000);
+    vector<string> dense = {string(64 * 1024, '<')};
+    beginGroup("escapeHtml, " + to_string(code.size()) + " code lines");
+    runBenchmark("three replace passes (legacy)", code, [](const string &line)
+                 { return legacy::escapeHtml(line); });
+    runBenchmark("single pass, exact size", code, [&](const string &line)
+                 { return ConverterBench::escapeHtml(converter, line); });
+    beginGroup("escapeHtml, one 64 KB line of '<'");
+    runBenchmark("three replace passes (legacy)", dense, [](const string &line)
+                 { return legacy::escapeHtml(line); });
+    runBenchmark("single pass, exact size", dense, [&](const string &line)
+                 { return ConverterBench::escapeHtml(converter, line); });
+
+    vector<string> headings;
+    vector<string> rows;
+    CorpusGenerator proseSource(CorpusKind::Prose);
+    CorpusGenerator tableSource(CorpusKind::Tables);
+    string text;
+    while (headings.size() < 2000 || rows.size() < 2000)
+    {
+        text.clear();
+        proseSource.block(text);
+        tableSource.block(text);
+        stringstream blockLines(text);
+        string line;
+        while (getline(blockLines, line))
+        {
+            if (line.compare(0, 1, "#") == 0 && headings.size() < 2000)
+                headings.push_back(line.substr(line.find(' ') + 1) + " & Notes (v2)");
+            else if (line.compare(0, 1, "|") == 0 && rows.size() < 2000)
+                rows.push_back(line);
+        }
+    }
+    beginGroup("generateId, " + to_string(headings.size()) + " headings");
+    runBenchmark("generateId", headings, [&](const string &heading)
+                 { return ConverterBench::generateId(converter, heading); });
+    beginGroup("parseTableRow, " + to_string(rows.size()) + " table rows");
+    runBenchmark("parseTableRow", rows, [&](const string &row)
+                 { return ConverterBench::parseTableRow(converter, row); });
+
+    const size_t tableRows = 100000;
+    vector<string> tableDoc = {generateTableDocument(tableRows)};
+    MarkdownConverter tableConverter;
+    beginGroup("table engine, one table of " + to_string(tableRows) + " rows");
+    runBenchmark("convertToHTML", tableDoc, [&](const string &doc)
+                 { return tableConverter.convertToHTML(doc); });
+    if (!jsonOutput)
+    {
+        const BenchResult &r = benchResults.back();
+        cout << "  " << fixed << setprecision(0) << static_cast<double>(tableRows * r.iterations) / r.seconds << " rows/s\n";
+    }
+
+    // The same C++ without a language is only escaped: the cost of the
+    // highlighter is the difference
+    beginGroup("syntax highlighting, one 1 MB code block");
+    for (const char *language : {"", "cpp", "python", "javascript", "bash", "json", "yaml", "sql"})
+    {
+        vector<string> codeDoc = {generateCodeBlock(language, 1 << 20)};
+        MarkdownConverter codeConverter;
+        runBenchmark(*language != '\0' ? language : "no language, escaped only", codeDoc, [&](const string &doc)
+                     { return codeConverter.convertToHTML(doc); });
+    }
+
+    vector<string> prose = {generateProseDocument(2000)};
+    beginGroup("convertToHTML, " + to_string(prose[0].length() / 1024) + " KB of plain paragraphs");
+    runBenchmark("structural index", prose, [](const string &doc)
+                 { return MarkdownConverter().convertToHTML(doc); });
+
+    for (CorpusKind kind : corpusKinds)
+    {
+        beginGroup(string("convertToHTML, ") + corpusName(kind) + " corpus");
+        for (size_t size : sizes)
+        {
+            vector<string> doc = {generateCorpusDocument(kind, size)};
+            MarkdownConverter corpusConverter;
+            runBenchmark(string(corpusName(kind)) + " " + formatSize(size), doc, [&](const string &markdown)
+                         { return corpusConverter.convertToHTML(markdown); });
+        }
+    }
+
+    // Same patterns at 16x the size: MB/s should hold and p99 grow ~16x.
+    // Both stay under the default line length limit, so the parser is measured
+    for (const AdversarialPattern &pattern : adversarialPatterns)
+    {
+        beginGroup(string("adversarial input, ") + pattern.name);
+        for (size_t size : {size_t(32) << 10, size_t(512) << 10})
+        {
+            vector<string> doc = {pattern.generate(size)};
+            MarkdownConverter hostileConverter;
+            runBenchmark(formatSize(size), doc, [&](const string &markdown)
+                         { return hostileConverter.convertToHTML(markdown); });
+        }
+    }
+
+    string mixed;
+    for (int i = 0; i < 200; i++)
+    {
+        mixed += "## Section " + to_string(i) + "\n\n";
+        for (const string &line : generateInlineLines(10))
+            mixed += line + "\n";
+        mixed += "\n- item one\n  - nested *item*\n- item two\n\n| a | b |\n|---|---|\n| `x` | **y** |\n\n";
+        mixed += "```cpp\n";
+        for (const string &line : generateCodeLines(8))
+            mixed += line + "\n";
+        mixed += "```\n\n";
+    }
+    vector<string> mixedDoc = {mixed};
+    DocumentContext treeContext;
+    MarkdownConverter treeConverter;
+    beginGroup("document tree, " + to_string(mixed.length() / 1024) + " KB of mixed markdown");
+    runBenchmark("parse to tree", mixedDoc, [&](const string &doc)
+                 { return ConverterBench::parse(treeContext, doc); });
+    ConverterBench::parse(treeContext, mixed);
+    runBenchmark("render tree", mixedDoc, [&](const string &)
+                 { return ConverterBench::render(treeContext); });
+    runBenchmark("convertToHTML", mixedDoc, [&](const string &doc)
+                 { return treeConverter.convertToHTML(doc); });
+
+    // A short comment, as a request handler would see it: the cost of a
+    // fresh context per call against the shared converter's reused one
+    vector<string> comments = generateInlineLines(200);
+    const MarkdownConverter shared;
+    beginGroup("per-request setup, " + to_string(comments.size()) + " one-line comments");
+    runBenchmark("new DocumentContext per call", comments, [](const string &comment)
+                 {
+                     OutputBuffer out;
+                     DocumentContext().convertToHTML(comment, out);
+                     return out.length(); });
+    runBenchmark("shared const MarkdownConverter", comments, [&](const string &comment)
+                 {
+                     OutputBuffer out;
+                     shared.convertToHTML(comment, out);
+                     return out.length(); });
+
+    IncrementalDocument live(mixed);
+    beginGroup("live preview, one keystroke in " + to_string(mixed.length() / 1024) + " KB (" + to_string(live.segmentCount()) + " segments)");
+    runBenchmark("full convertToHTML", mixedDoc, [&](const string &doc)
+                 { return treeConverter.convertToHTML(doc); });
+    runBenchmark("IncrementalDocument::edit", mixedDoc, [&](const string &doc)
+                 { return live.edit(doc.length() / 2, 0, "a").fragments.size(); });
+
+    string large;
+    while (large.length() < 8 * 1024 * 1024)
+        large += mixed;
+    vector<string> largeDoc = {large};
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    beginGroup("convertToHTML, " + to_string(large.length() / (1024 * 1024)) + " MB split at blank lines");
+    for (unsigned threads = 1; threads <= cores; threads *= 2)
+    {
+        MarkdownConverter parallelConverter;
+        parallelConverter.setThreads(threads);
+        runBenchmark(to_string(threads) + (threads == 1 ? " thread" : " threads"), largeDoc, [&](const string &doc)
+                     { return parallelConverter.convertToHTML(doc); });
+    }
+
+    if (jsonOutput)
+        writeJson(cout);
+    return 0;
+}
@@ -1,938 +1,6984 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <regex>
 #include <string>
+#include <string_view>
+#include <memory>
+#include <deque>
+#include <new>
+#include <type_traits>
 #include <vector>
 #include <map>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <chrono>
+#include <csignal>
+#include <iomanip>
 #include <algorithm>
 #include <cctype>
+#include <climits>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#define MD2HTML_POSIX 1
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#define MD2HTML_INOTIFY 1
+#endif
+
+#include "md2html.h"
 
 using namespace std;
+namespace fs = std::filesystem;
 
-struct TocEntry
+// ---------------------------------------------------------------------------
+// Allocation accounting
+//
+// The executable replaces the global operator new so --alloc-stats can
+// count heap allocations, bytes and peak live bytes. Counting is off until
+// enabled; until then each allocation pays one relaxed load. Builds that
+// embed the converter define MD2HTML_NO_MAIN and keep their own allocator
+// unless they ask for this one with MD2HTML_COUNT_ALLOCATIONS.
+// ---------------------------------------------------------------------------
+
+struct AllocationCounters
 {
-    int level;
-    string id;
-    string text;
+    atomic<bool> enabled{false};
+    atomic<size_t> count{0};
+    atomic<size_t> bytes{0};
+    atomic<int64_t> live{0}; // Relative to when counting started; frees of older blocks take it below zero
+    atomic<int64_t> peak{0};
 };
 
-class MarkdownConverter
+static AllocationCounters allocationCounters;
+
+#if !defined(MD2HTML_NO_MAIN) || defined(MD2HTML_COUNT_ALLOCATIONS)
+// Size of a malloc block as the C library sees it, or 0 where it cannot
+// tell; live and peak bytes then stay at 0.
+static int64_t blockSize(void *p)
 {
-private:
-    bool inList = false;
-    bool inOrderedList = false;
-    bool inCodeBlock = false;
-    bool inTable = false;
-    int listDepth = 0;
-    vector<TocEntry> tocEntries;
-    map<string, string> footnotes;
-    map<string, string> emojiMap;
-
-    void initializeEmojiMap()
-    {
-        emojiMap[":smile:"] = "😊";
-        emojiMap[":heart:"] = "❤️";
-        emojiMap[":thumbsup:"] = "👍";
-        emojiMap[":thumbsdown:"] = "👎";
-        emojiMap[":fire:"] = "🔥";
-        emojiMap[":star:"] = "⭐";
-        emojiMap[":rocket:"] = "🚀";
-        emojiMap[":tada:"] = "🎉";
-        emojiMap[":eyes:"] = "👀";
-        emojiMap[":laugh:"] = "😂";
-        emojiMap[":cry:"] = "😢";
-        emojiMap[":angry:"] = "😠";
-        emojiMap[":cool:"] = "😎";
-        emojiMap[":wink:"] = "😉";
-        emojiMap[":thinking:"] = "🤔";
-        emojiMap[":check:"] = "✅";
-        emojiMap[":x:"] = "❌";
-        emojiMap[":warning:"] = "⚠️";
-        emojiMap[":info:"] = "ℹ️";
-        emojiMap[":bulb:"] = "💡";
-    }
-
-    string trim(const string &str)
-    {
-        size_t start = str.find_first_not_of(" \t\r\n");
-        if (start == string::npos)
-            return "";
-        size_t end = str.find_last_not_of(" \t\r\n");
-        return str.substr(start, end - start + 1);
-    }
+#if defined(__GLIBC__)
+    return static_cast<int64_t>(malloc_usable_size(p));
+#elif defined(__APPLE__)
+    return static_cast<int64_t>(malloc_size(p));
+#else
+    (void)p;
+    return 0;
+#endif
+}
 
-    string escapeHtml(const string &text)
+void *operator new(size_t size)
+{
+    void *p = malloc(size != 0 ? size : 1);
+    if (p == nullptr)
+        throw bad_alloc();
+    if (allocationCounters.enabled.load(memory_order_relaxed))
     {
-        string escaped = text;
-        size_t pos = 0;
-        while ((pos = escaped.find("&", pos)) != string::npos)
-        {
-            escaped.replace(pos, 1, "&amp;");
-            pos += 5;
-        }
-        pos = 0;
-        while ((pos = escaped.find("<", pos)) != string::npos)
-        {
-            escaped.replace(pos, 1, "&lt;");
-            pos += 4;
-        }
-        pos = 0;
-        while ((pos = escaped.find(">", pos)) != string::npos)
+        allocationCounters.count.fetch_add(1, memory_order_relaxed);
+        allocationCounters.bytes.fetch_add(size, memory_order_relaxed);
+        int64_t block = blockSize(p);
+        int64_t live = allocationCounters.live.fetch_add(block, memory_order_relaxed) + block;
+        int64_t peak = allocationCounters.peak.load(memory_order_relaxed);
+        while (live > peak && !allocationCounters.peak.compare_exchange_weak(peak, live, memory_order_relaxed))
         {
-            escaped.replace(pos, 1, "&gt;");
-            pos += 4;
         }
-        return escaped;
     }
+    return p;
+}
 
-    string processEmojis(string text)
-    {
-        for (const auto &emoji : emojiMap)
-        {
-            size_t pos = 0;
-            while ((pos = text.find(emoji.first, pos)) != string::npos)
-            {
-                text.replace(pos, emoji.first.length(), emoji.second);
-                pos += emoji.second.length();
-            }
-        }
-        return text;
-    }
+void operator delete(void *p) noexcept
+{
+    if (p != nullptr && allocationCounters.enabled.load(memory_order_relaxed))
+        allocationCounters.live.fetch_sub(blockSize(p), memory_order_relaxed);
+    free(p);
+}
 
-    string processMath(string line)
-    {
-        // Block math: $$...$$
-        line = regex_replace(line, regex("\\$\\$([^$]+)\\$\\$"), "<div class=\"math-block\">$1</div>");
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+#endif
 
-        // Inline math: $...$
-        line = regex_replace(line, regex("\\$([^$]+)\\$"), "<span class=\"math-inline\">$1</span>");
+// ---------------------------------------------------------------------------
+// Character classification
+//
+// The first stage scans the whole input once and marks every byte that can
+// matter to the block or inline parser. Runs of plain prose between marks are
+// then copied or skipped in bulk instead of being inspected byte by byte.
+// ---------------------------------------------------------------------------
 
-        return line;
-    }
+// Characters the block stage cares about
+static const char structuralChars[] = "`*_[]!()$~:<>&|#\n";
 
-    string generateId(const string &text)
-    {
-        string id = text;
-        transform(id.begin(), id.end(), id.begin(), ::tolower);
+// Characters that can start inline markup (or need escaping) inside a line
+static const char inlineSpecialChars[] = "`$![:*_~&<>";
 
-        // Replace spaces and special chars with hyphens
-        for (char &c : id)
-        {
-            if (!isalnum(c))
-                c = '-';
-        }
+#if defined(__AVX2__)
+static const size_t simdWidth = 32;
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+static const size_t simdWidth = 16;
+#else
+static const size_t simdWidth = 0;
+#endif
 
-        // Remove multiple consecutive hyphens
-        id = regex_replace(id, regex("-+"), "-");
+static inline unsigned countTrailingZeros(uint64_t x)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(x));
+#endif
+}
 
-        // Remove leading/trailing hyphens
-        if (!id.empty() && id.front() == '-')
-            id.erase(0, 1);
-        if (!id.empty() && id.back() == '-')
-            id.pop_back();
+// Bit i of the result is set when p[i] is one of the first setLen characters
+// of set. Reads exactly simdWidth bytes.
+static inline uint32_t matchMask(const char *p, const char *set, size_t setLen)
+{
+#if defined(__AVX2__)
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hits = _mm256_setzero_si256();
+    for (size_t k = 0; k < setLen; k++)
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(set[k])));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i hits = _mm_setzero_si128();
+    for (size_t k = 0; k < setLen; k++)
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(set[k])));
+    return static_cast<uint32_t>(_mm_movemask_epi8(hits));
+#else
+    (void)p;
+    (void)set;
+    (void)setLen;
+    return 0;
+#endif
+}
 
-        return id;
-    }
+// 256-entry membership table for the scalar paths
+struct CharTable
+{
+    bool member[256] = {};
 
-    string processTaskList(const string &line)
+    explicit CharTable(const char *set)
     {
-        if (line.length() < 6)
-            return line;
+        for (; *set; set++)
+            member[static_cast<unsigned char>(*set)] = true;
+    }
 
-        if (line.substr(0, 6) == "- [x] " || line.substr(0, 6) == "- [X] ")
-        {
-            string content = trim(line.substr(6));
-            return "<li class=\"task-item\"><input type=\"checkbox\" checked disabled> " + processInlineFormatting(content) + "</li>";
-        }
-        else if (line.substr(0, 6) == "- [ ] ")
-        {
-            string content = trim(line.substr(6));
-            return "<li class=\"task-item\"><input type=\"checkbox\" disabled> " + processInlineFormatting(content) + "</li>";
-        }
+    bool operator[](char c) const { return member[static_cast<unsigned char>(c)]; }
+};
 
-        return line;
-    }
+static const CharTable structuralTable(structuralChars);
+static const CharTable inlineSpecialTable(inlineSpecialChars);
 
-    vector<string> parseTableRow(const string &line)
+// Offset of the first character of set in [p, p + n), or n. table must hold
+// the same characters as set.
+static inline size_t findFirstOf(const char *p, size_t n, const char *set, size_t setLen, const CharTable &table)
+{
+    size_t i = 0;
+    if (simdWidth > 0)
     {
-        vector<string> cells;
-        string trimmed = trim(line);
-
-        // Remove leading and trailing pipes if they exist
-        if (!trimmed.empty() && trimmed.front() == '|')
-        {
-            trimmed = trimmed.substr(1);
-        }
-        if (!trimmed.empty() && trimmed.back() == '|')
+        for (; i + simdWidth <= n; i += simdWidth)
         {
-            trimmed = trimmed.substr(0, trimmed.length() - 1);
+            uint32_t mask = matchMask(p + i, set, setLen);
+            if (mask != 0)
+                return i + countTrailingZeros(mask);
         }
+    }
+    while (i < n && !table[p[i]])
+        i++;
+    return i;
+}
 
-        stringstream ss(trimmed);
-        string cell;
+static inline size_t findInlineSpecial(const char *p, size_t n)
+{
+    return findFirstOf(p, n, inlineSpecialChars, sizeof(inlineSpecialChars) - 1, inlineSpecialTable);
+}
 
-        while (getline(ss, cell, '|'))
-        {
-            cells.push_back(trim(cell));
-        }
+// Characters that end or escape a table cell
+static const char tableCellChars[] = "|\\";
+static const CharTable tableCellTable(tableCellChars);
 
-        return cells;
-    }
+// Offset of the first pipe or backslash in s at or after from, or npos
+static inline size_t findTableCellEnd(string_view s, size_t from)
+{
+    if (from >= s.length())
+        return string_view::npos;
+    size_t i = from + findFirstOf(s.data() + from, s.length() - from, tableCellChars, sizeof(tableCellChars) - 1, tableCellTable);
+    return i < s.length() ? i : string_view::npos;
+}
+
+// Characters escaped in HTML text; attribute values also escape '"'
+static const char htmlTextEscapes[] = "&<>";
+static const char htmlAttributeEscapes[] = "&<>\"";
+static const CharTable htmlTextEscapeTable(htmlTextEscapes);
+static const CharTable htmlAttributeEscapeTable(htmlAttributeEscapes);
 
-    bool isTableSeparator(const string &line)
+static inline const char *htmlEntity(char c)
+{
+    switch (c)
     {
-        vector<string> parts = parseTableRow(line);
-        if (parts.empty())
-            return false;
+    case '&':
+        return "&amp;";
+    case '<':
+        return "&lt;";
+    case '>':
+        return "&gt;";
+    default:
+        return "&quot;";
+    }
+}
 
-        for (const string &part : parts)
-        {
-            string trimmed = trim(part);
-            if (trimmed.empty())
-                return false;
+static inline size_t htmlEntityLength(char c)
+{
+    return c == '&' ? 5 : c == '"' ? 6 : 4;
+}
 
-            // Check if it contains only allowed characters: -, :, and spaces
-            for (char c : trimmed)
+// Calls fn(offset) for every character of set in [p, p + n), in order.
+template <typename Fn>
+static inline void forEachOf(const char *p, size_t n, const char *set, size_t setLen, const CharTable &table, Fn fn)
+{
+    size_t i = 0;
+    if (simdWidth > 0)
+    {
+        for (; i + simdWidth <= n; i += simdWidth)
+        {
+            uint32_t mask = matchMask(p + i, set, setLen);
+            while (mask != 0)
             {
-                if (c != '-' && c != ':' && c != ' ')
-                {
-                    return false;
-                }
+                fn(i + countTrailingZeros(mask));
+                mask &= mask - 1;
             }
-
-            // Must contain at least one dash
-            if (trimmed.find('-') == string::npos)
-                return false;
         }
-
-        return true;
     }
+    for (; i < n; i++)
+    {
+        if (table[p[i]])
+            fn(i);
+    }
+}
+
+// Appends p[0..n) to out with HTML escapes applied. One counting pass sizes
+// the output exactly, then clean runs are copied in bulk between entities.
+static void appendHtmlEscaped(string &out, const char *p, size_t n, bool attribute = false)
+{
+    const char *set = attribute ? htmlAttributeEscapes : htmlTextEscapes;
+    const size_t setLen = attribute ? sizeof(htmlAttributeEscapes) - 1 : sizeof(htmlTextEscapes) - 1;
+    const CharTable &table = attribute ? htmlAttributeEscapeTable : htmlTextEscapeTable;
 
-    int getIndentLevel(const string &line)
+    size_t extra = 0;
+    forEachOf(p, n, set, setLen, table, [&](size_t i)
+              { extra += htmlEntityLength(p[i]) - 1; });
+    if (extra == 0)
     {
-        int level = 0;
-        for (char c : line)
-        {
-            if (c == ' ')
-                level++;
-            else if (c == '\t')
-                level += 4;
-            else
-                break;
-        }
-        return level / 2; // Assuming 2 spaces per indent level
+        out.append(p, n);
+        return;
     }
 
-    string processFootnotes(string line)
+    size_t start = out.length();
+    out.resize(start + n + extra);
+    char *dst = &out[start];
+    size_t last = 0;
+    forEachOf(p, n, set, setLen, table, [&](size_t i)
+              {
+                  memcpy(dst, p + last, i - last);
+                  dst += i - last;
+                  size_t len = htmlEntityLength(p[i]);
+                  memcpy(dst, htmlEntity(p[i]), len);
+                  dst += len;
+                  last = i + 1; });
+    memcpy(dst, p + last, n - last);
+}
+
+// Bitmap with one bit per input byte, set for structural characters.
+class StructuralIndex
+{
+private:
+    vector<uint64_t> bits;
+    size_t length = 0;
+
+public:
+    explicit StructuralIndex(string_view text) : bits((text.length() + 63) / 64, 0), length(text.length())
     {
-        try
+        const char *p = text.data();
+        size_t i = 0;
+        if (simdWidth > 0)
         {
-            // Process footnote references [^1]
-            line = regex_replace(line, regex("\\[\\^([^\\]]+)\\]"), "<sup><a href=\"#fn$1\" id=\"fnref$1\">$1</a></sup>");
+            const size_t setLen = sizeof(structuralChars) - 1;
+            for (; i + 64 <= length; i += 64)
+            {
+                uint64_t word = 0;
+                for (size_t k = 0; k < 64; k += simdWidth)
+                    word |= static_cast<uint64_t>(matchMask(p + i + k, structuralChars, setLen)) << k;
+                bits[i / 64] = word;
+            }
         }
-        catch (const regex_error &e)
+        for (; i < length; i++)
         {
-            cerr << "Regex error in footnotes: " << e.what() << endl;
+            if (structuralTable[p[i]])
+                bits[i / 64] |= uint64_t(1) << (i % 64);
         }
-        return line;
     }
 
-    string processInlineFormatting(string line)
+    // Position of the first structural character in [from, to), or to.
+    size_t next(size_t from, size_t to) const
     {
-        try
+        if (to > length)
+            to = length;
+        while (from < to)
         {
-            // Escape HTML first
-            line = escapeHtml(line);
+            uint64_t word = bits[from / 64] >> (from % 64);
+            if (word != 0)
+            {
+                size_t pos = from + countTrailingZeros(word);
+                return pos < to ? pos : to;
+            }
+            from = (from / 64 + 1) * 64;
+        }
+        return to;
+    }
 
-            // Process emojis
-            line = processEmojis(line);
+    bool any(size_t from, size_t to) const
+    {
+        return next(from, to) < to;
+    }
+};
 
-            // Process math
-            line = processMath(line);
+// Source of input lines for the block parser. plain is set when the line
+// holds no structural characters at all. A returned line stays valid until
+// next() has been called twice more, which leaves room for one line of
+// lookahead.
+class LineSource
+{
+public:
+    virtual ~LineSource() = default;
+    virtual bool next(string_view &line, bool &plain) = 0;
 
-            // Process footnotes
-            line = processFootnotes(line);
+    // Hands the last line back once the caller is done with it, so its
+    // storage can be reused by the following call.
+    virtual void release() {}
 
-            // Code spans (must be processed before other formatting)
-            line = regex_replace(line, regex("`([^`]+)`"), "<code>$1</code>");
+    // True when lines stay valid for as long as the source itself.
+    virtual bool persistent() const { return false; }
+};
 
-            // Images: ![alt](src)
-            line = regex_replace(line, regex("!\\[([^\\]]*)\\]\\(([^)]+)\\)"), "<img src=\"$2\" alt=\"$1\">");
+// Lines of a document held in memory (or mapped from a file), returned as
+// views into it and classified through its StructuralIndex.
+class DocumentLines : public LineSource
+{
+private:
+    string_view text;
+    StructuralIndex index;
+    size_t pos = 0;
 
-            // Links: [text](url)
-            line = regex_replace(line, regex("\\[([^\\]]+)\\]\\(([^)]+)\\)"), "<a href=\"$2\">$1</a>");
+public:
+    explicit DocumentLines(string_view document) : text(document), index(document) {}
 
-            // Auto-link raw URLs (http/https)
-            line = regex_replace(line, regex(R"((https?://[^\s)]+))"), "<a href=\"$1\">$1</a>");
+    bool next(string_view &line, bool &plain) override
+    {
+        if (pos >= text.length())
+            return false;
+        size_t newline = text.find('\n', pos);
+        size_t lineEnd = newline == string_view::npos ? text.length() : newline;
+        line = text.substr(pos, lineEnd - pos);
+        plain = !index.any(pos, lineEnd);
+        pos = lineEnd + 1;
+        return true;
+    }
 
-            // Bold
-            line = regex_replace(line, regex("\\*\\*([^*]+)\\*\\*"), "<strong>$1</strong>");
-            line = regex_replace(line, regex("__([^_]+)__"), "<strong>$1</strong>");
+    bool persistent() const override { return true; }
+};
 
-            // Italic
-            line = regex_replace(line, regex("\\*([^*]+)\\*"), "<em>$1</em>");
-            line = regex_replace(line, regex("_([^_]+)_"), "<em>$1</em>");
+// Lines read one at a time from a stream, alternating between two buffers
+// so the previous line survives while the next one is read.
+class StreamLines : public LineSource
+{
+private:
+    istream &in;
+    string buffers[2];
+    int current = 0;
+    size_t bytes = 0;
 
-            // Strikethrough
-            line = regex_replace(line, regex("~~([^~]+)~~"), "<del>$1</del>");
-        }
-        catch (const regex_error &e)
-        {
-            cerr << "Regex error in inline formatting: " << e.what() << endl;
-        }
+public:
+    explicit StreamLines(istream &input) : in(input) {}
 
-        return line;
+    bool next(string_view &line, bool &plain) override
+    {
+        current ^= 1;
+        string &buffer = buffers[current];
+        if (!getline(in, buffer))
+            return false;
+        bytes += buffer.length() + (in.eof() ? 0 : 1);
+        line = buffer;
+        plain = findFirstOf(buffer.data(), buffer.length(), structuralChars, sizeof(structuralChars) - 1, structuralTable) == buffer.length();
+        return true;
     }
 
-    string processHeading(const string &line)
+    void release() override
     {
-        int level = 0;
-        for (char c : line)
-        {
-            if (c == '#')
-                level++;
-            else
-                break;
-        }
+        current ^= 1;
+    }
 
-        if (level > 6)
-            level = 6;
+    size_t bytesRead() const { return bytes; }
+};
+
+// ---------------------------------------------------------------------------
+// Emoji shortcodes
+//
+// The GitHub shortcode set, followed by the few names md2html accepted before
+// it had the full set. The lookup table is built by the compiler, so nothing is set up
+// at runtime and a lookup hashes the name once and probes a handful of slots.
+// ---------------------------------------------------------------------------
+
+struct EmojiEntry
+{
+    const char *name;
+    const char *emoji;
+};
+
+static constexpr EmojiEntry emojiEntries[] = {
+    {"grinning", "😀"}, {"smiley", "😃"}, {"grin", "😁"}, {"laughing", "😆"},
+    {"satisfied", "😆"}, {"sweat_smile", "😅"}, {"rofl", "🤣"}, {"joy", "😂"},
+    {"slightly_smiling_face", "🙂"}, {"upside_down_face", "🙃"}, {"melting_face", "🫠"}, {"wink", "😉"},
+    {"blush", "😊"}, {"innocent", "😇"}, {"smiling_face_with_three_hearts", "🥰"}, {"heart_eyes", "😍"},
+    {"star_struck", "🤩"}, {"kissing_heart", "😘"}, {"kissing", "😗"}, {"relaxed", "☺️"},
+    {"kissing_closed_eyes", "😚"}, {"kissing_smiling_eyes", "😙"}, {"smiling_face_with_tear", "🥲"},
+    {"yum", "😋"}, {"stuck_out_tongue", "😛"}, {"stuck_out_tongue_winking_eye", "😜"},
+    {"zany_face", "🤪"}, {"stuck_out_tongue_closed_eyes", "😝"}, {"money_mouth_face", "🤑"},
+    {"hugs", "🤗"}, {"hand_over_mouth", "🤭"}, {"face_with_open_eyes_and_hand_over_mouth", "🫢"},
+    {"face_with_peeking_eye", "🫣"}, {"shushing_face", "🤫"}, {"thinking", "🤔"},
+    {"saluting_face", "🫡"}, {"zipper_mouth_face", "🤐"}, {"raised_eyebrow", "🤨"},
+    {"neutral_face", "😐"}, {"expressionless", "😑"}, {"no_mouth", "😶"}, {"dotted_line_face", "🫥"},
+    {"face_in_clouds", "😶‍🌫️"}, {"smirk", "😏"}, {"unamused", "😒"}, {"roll_eyes", "🙄"},
+    {"grimacing", "😬"}, {"face_exhaling", "😮‍💨"}, {"lying_face", "🤥"}, {"shaking_face", "🫨"},
+    {"relieved", "😌"}, {"pensive", "😔"}, {"sleepy", "😪"}, {"drooling_face", "🤤"}, {"sleeping", "😴"},
+    {"mask", "😷"}, {"face_with_thermometer", "🤒"}, {"face_with_head_bandage", "🤕"},
+    {"nauseated_face", "🤢"}, {"vomiting_face", "🤮"}, {"sneezing_face", "🤧"}, {"hot_face", "🥵"},
+    {"cold_face", "🥶"}, {"woozy_face", "🥴"}, {"dizzy_face", "😵"}, {"face_with_spiral_eyes", "😵‍💫"},
+    {"exploding_head", "🤯"}, {"cowboy_hat_face", "🤠"}, {"partying_face", "🥳"},
+    {"disguised_face", "🥸"}, {"sunglasses", "😎"}, {"nerd_face", "🤓"}, {"monocle_face", "🧐"},
+    {"confused", "😕"}, {"face_with_diagonal_mouth", "🫤"}, {"worried", "😟"},
+    {"slightly_frowning_face", "🙁"}, {"frowning_face", "☹️"}, {"open_mouth", "😮"}, {"hushed", "😯"},
+    {"astonished", "😲"}, {"flushed", "😳"}, {"pleading_face", "🥺"}, {"face_holding_back_tears", "🥹"},
+    {"frowning", "😦"}, {"anguished", "😧"}, {"fearful", "😨"}, {"cold_sweat", "😰"},
+    {"disappointed_relieved", "😥"}, {"cry", "😢"}, {"sob", "😭"}, {"scream", "😱"},
+    {"confounded", "😖"}, {"persevere", "😣"}, {"disappointed", "😞"}, {"sweat", "😓"}, {"weary", "😩"},
+    {"tired_face", "😫"}, {"yawning_face", "🥱"}, {"triumph", "😤"}, {"rage", "😡"}, {"pout", "😡"},
+    {"angry", "😠"}, {"cursing_face", "🤬"}, {"smiling_imp", "😈"}, {"imp", "👿"}, {"skull", "💀"},
+    {"skull_and_crossbones", "☠️"}, {"hankey", "💩"}, {"poop", "💩"}, {"shit", "💩"},
+    {"clown_face", "🤡"}, {"japanese_ogre", "👹"}, {"japanese_goblin", "👺"}, {"ghost", "👻"},
+    {"alien", "👽"}, {"space_invader", "👾"}, {"robot", "🤖"}, {"smiley_cat", "😺"}, {"smile_cat", "😸"},
+    {"joy_cat", "😹"}, {"heart_eyes_cat", "😻"}, {"smirk_cat", "😼"}, {"kissing_cat", "😽"},
+    {"scream_cat", "🙀"}, {"crying_cat_face", "😿"}, {"pouting_cat", "😾"}, {"see_no_evil", "🙈"},
+    {"hear_no_evil", "🙉"}, {"speak_no_evil", "🙊"}, {"love_letter", "💌"}, {"cupid", "💘"},
+    {"gift_heart", "💝"}, {"sparkling_heart", "💖"}, {"heartpulse", "💗"}, {"heartbeat", "💓"},
+    {"revolving_hearts", "💞"}, {"two_hearts", "💕"}, {"heart_decoration", "💟"},
+    {"heavy_heart_exclamation", "❣️"}, {"broken_heart", "💔"}, {"heart_on_fire", "❤️‍🔥"},
+    {"mending_heart", "❤️‍🩹"}, {"heart", "❤️"}, {"pink_heart", "🩷"}, {"orange_heart", "🧡"},
+    {"yellow_heart", "💛"}, {"green_heart", "💚"}, {"blue_heart", "💙"}, {"light_blue_heart", "🩵"},
+    {"purple_heart", "💜"}, {"brown_heart", "🤎"}, {"black_heart", "🖤"}, {"grey_heart", "🩶"},
+    {"white_heart", "🤍"}, {"kiss", "💋"}, {"100", "💯"}, {"anger", "💢"}, {"boom", "💥"},
+    {"collision", "💥"}, {"dizzy", "💫"}, {"sweat_drops", "💦"}, {"dash", "💨"}, {"hole", "🕳️"},
+    {"speech_balloon", "💬"}, {"eye_speech_bubble", "👁️‍🗨️"}, {"left_speech_bubble", "🗨️"},
+    {"right_anger_bubble", "🗯️"}, {"thought_balloon", "💭"}, {"zzz", "💤"}, {"wave", "👋"},
+    {"raised_back_of_hand", "🤚"}, {"raised_hand_with_fingers_splayed", "🖐️"}, {"hand", "✋"},
+    {"raised_hand", "✋"}, {"vulcan_salute", "🖖"}, {"rightwards_hand", "🫱"}, {"leftwards_hand", "🫲"},
+    {"palm_down_hand", "🫳"}, {"palm_up_hand", "🫴"}, {"leftwards_pushing_hand", "🫷"},
+    {"rightwards_pushing_hand", "🫸"}, {"ok_hand", "👌"}, {"pinched_fingers", "🤌"},
+    {"pinching_hand", "🤏"}, {"v", "✌️"}, {"crossed_fingers", "🤞"},
+    {"hand_with_index_finger_and_thumb_crossed", "🫰"}, {"love_you_gesture", "🤟"}, {"metal", "🤘"},
+    {"call_me_hand", "🤙"}, {"point_left", "👈"}, {"point_right", "👉"}, {"point_up_2", "👆"},
+    {"middle_finger", "🖕"}, {"fu", "🖕"}, {"point_down", "👇"}, {"point_up", "☝️"},
+    {"index_pointing_at_the_viewer", "🫵"}, {"+1", "👍"}, {"thumbsup", "👍"}, {"-1", "👎"},
+    {"thumbsdown", "👎"}, {"fist_raised", "✊"}, {"fist", "✊"}, {"fist_oncoming", "👊"},
+    {"facepunch", "👊"}, {"punch", "👊"}, {"fist_left", "🤛"}, {"fist_right", "🤜"}, {"clap", "👏"},
+    {"raised_hands", "🙌"}, {"heart_hands", "🫶"}, {"open_hands", "👐"}, {"palms_up_together", "🤲"},
+    {"handshake", "🤝"}, {"pray", "🙏"}, {"writing_hand", "✍️"}, {"nail_care", "💅"}, {"selfie", "🤳"},
+    {"muscle", "💪"}, {"mechanical_arm", "🦾"}, {"mechanical_leg", "🦿"}, {"leg", "🦵"}, {"foot", "🦶"},
+    {"ear", "👂"}, {"ear_with_hearing_aid", "🦻"}, {"nose", "👃"}, {"brain", "🧠"},
+    {"anatomical_heart", "🫀"}, {"lungs", "🫁"}, {"tooth", "🦷"}, {"bone", "🦴"}, {"eyes", "👀"},
+    {"eye", "👁️"}, {"tongue", "👅"}, {"lips", "👄"}, {"biting_lip", "🫦"}, {"baby", "👶"},
+    {"child", "🧒"}, {"boy", "👦"}, {"girl", "👧"}, {"adult", "🧑"}, {"blond_haired_person", "👱"},
+    {"man", "👨"}, {"bearded_person", "🧔"}, {"man_beard", "🧔‍♂️"}, {"woman_beard", "🧔‍♀️"},
+    {"red_haired_man", "👨‍🦰"}, {"curly_haired_man", "👨‍🦱"}, {"white_haired_man", "👨‍🦳"},
+    {"bald_man", "👨‍🦲"}, {"woman", "👩"}, {"red_haired_woman", "👩‍🦰"}, {"curly_haired_woman", "👩‍🦱"},
+    {"white_haired_woman", "👩‍🦳"}, {"bald_woman", "👩‍🦲"}, {"blond_haired_woman", "👱‍♀️"},
+    {"blonde_woman", "👱‍♀️"}, {"blond_haired_man", "👱‍♂️"}, {"older_adult", "🧓"},
+    {"older_man", "👴"}, {"older_woman", "👵"}, {"frowning_person", "🙍"}, {"frowning_man", "🙍‍♂️"},
+    {"frowning_woman", "🙍‍♀️"}, {"pouting_face", "🙎"}, {"pouting_man", "🙎‍♂️"},
+    {"pouting_woman", "🙎‍♀️"}, {"no_good", "🙅"}, {"no_good_man", "🙅‍♂️"}, {"ng_man", "🙅‍♂️"},
+    {"no_good_woman", "🙅‍♀️"}, {"ng_woman", "🙅‍♀️"}, {"ok_person", "🙆"}, {"ok_man", "🙆‍♂️"},
+    {"ok_woman", "🙆‍♀️"}, {"tipping_hand_person", "💁"}, {"information_desk_person", "💁"},
+    {"tipping_hand_man", "💁‍♂️"}, {"sassy_man", "💁‍♂️"}, {"tipping_hand_woman", "💁‍♀️"},
+    {"sassy_woman", "💁‍♀️"}, {"raising_hand", "🙋"}, {"raising_hand_man", "🙋‍♂️"},
+    {"raising_hand_woman", "🙋‍♀️"}, {"deaf_person", "🧏"}, {"deaf_man", "🧏‍♂️"},
+    {"deaf_woman", "🧏‍♀️"}, {"bow", "🙇"}, {"bowing_man", "🙇‍♂️"}, {"bowing_woman", "🙇‍♀️"},
+    {"facepalm", "🤦"}, {"man_facepalming", "🤦‍♂️"}, {"woman_facepalming", "🤦‍♀️"}, {"shrug", "🤷"},
+    {"man_shrugging", "🤷‍♂️"}, {"woman_shrugging", "🤷‍♀️"}, {"health_worker", "🧑‍⚕️"},
+    {"man_health_worker", "👨‍⚕️"}, {"woman_health_worker", "👩‍⚕️"}, {"student", "🧑‍🎓"},
+    {"man_student", "👨‍🎓"}, {"woman_student", "👩‍🎓"}, {"teacher", "🧑‍🏫"}, {"man_teacher", "👨‍🏫"},
+    {"woman_teacher", "👩‍🏫"}, {"judge", "🧑‍⚖️"}, {"man_judge", "👨‍⚖️"}, {"woman_judge", "👩‍⚖️"},
+    {"farmer", "🧑‍🌾"}, {"man_farmer", "👨‍🌾"}, {"woman_farmer", "👩‍🌾"}, {"cook", "🧑‍🍳"},
+    {"man_cook", "👨‍🍳"}, {"woman_cook", "👩‍🍳"}, {"mechanic", "🧑‍🔧"}, {"man_mechanic", "👨‍🔧"},
+    {"woman_mechanic", "👩‍🔧"}, {"factory_worker", "🧑‍🏭"}, {"man_factory_worker", "👨‍🏭"},
+    {"woman_factory_worker", "👩‍🏭"}, {"office_worker", "🧑‍💼"}, {"man_office_worker", "👨‍💼"},
+    {"woman_office_worker", "👩‍💼"}, {"scientist", "🧑‍🔬"}, {"man_scientist", "👨‍🔬"},
+    {"woman_scientist", "👩‍🔬"}, {"technologist", "🧑‍💻"}, {"man_technologist", "👨‍💻"},
+    {"woman_technologist", "👩‍💻"}, {"singer", "🧑‍🎤"}, {"man_singer", "👨‍🎤"},
+    {"woman_singer", "👩‍🎤"}, {"artist", "🧑‍🎨"}, {"man_artist", "👨‍🎨"}, {"woman_artist", "👩‍🎨"},
+    {"pilot", "🧑‍✈️"}, {"man_pilot", "👨‍✈️"}, {"woman_pilot", "👩‍✈️"}, {"astronaut", "🧑‍🚀"},
+    {"man_astronaut", "👨‍🚀"}, {"woman_astronaut", "👩‍🚀"}, {"firefighter", "🧑‍🚒"},
+    {"man_firefighter", "👨‍🚒"}, {"woman_firefighter", "👩‍🚒"}, {"police_officer", "👮"}, {"cop", "👮"},
+    {"policeman", "👮‍♂️"}, {"policewoman", "👮‍♀️"}, {"detective", "🕵️"},
+    {"male_detective", "🕵️‍♂️"}, {"female_detective", "🕵️‍♀️"}, {"guard", "💂"},
+    {"guardsman", "💂‍♂️"}, {"guardswoman", "💂‍♀️"}, {"ninja", "🥷"}, {"construction_worker", "👷"},
+    {"construction_worker_man", "👷‍♂️"}, {"construction_worker_woman", "👷‍♀️"},
+    {"person_with_crown", "🫅"}, {"prince", "🤴"}, {"princess", "👸"}, {"person_with_turban", "👳"},
+    {"man_with_turban", "👳‍♂️"}, {"woman_with_turban", "👳‍♀️"}, {"man_with_gua_pi_mao", "👲"},
+    {"woman_with_headscarf", "🧕"}, {"person_in_tuxedo", "🤵"}, {"man_in_tuxedo", "🤵‍♂️"},
+    {"woman_in_tuxedo", "🤵‍♀️"}, {"person_with_veil", "👰"}, {"man_with_veil", "👰‍♂️"},
+    {"woman_with_veil", "👰‍♀️"}, {"bride_with_veil", "👰‍♀️"}, {"pregnant_woman", "🤰"},
+    {"pregnant_man", "🫃"}, {"pregnant_person", "🫄"}, {"breast_feeding", "🤱"},
+    {"woman_feeding_baby", "👩‍🍼"}, {"man_feeding_baby", "👨‍🍼"}, {"person_feeding_baby", "🧑‍🍼"},
+    {"angel", "👼"}, {"santa", "🎅"}, {"mrs_claus", "🤶"}, {"mx_claus", "🧑‍🎄"}, {"superhero", "🦸"},
+    {"superhero_man", "🦸‍♂️"}, {"superhero_woman", "🦸‍♀️"}, {"supervillain", "🦹"},
+    {"supervillain_man", "🦹‍♂️"}, {"supervillain_woman", "🦹‍♀️"}, {"mage", "🧙"},
+    {"mage_man", "🧙‍♂️"}, {"mage_woman", "🧙‍♀️"}, {"fairy", "🧚"}, {"fairy_man", "🧚‍♂️"},
+    {"fairy_woman", "🧚‍♀️"}, {"vampire", "🧛"}, {"vampire_man", "🧛‍♂️"}, {"vampire_woman", "🧛‍♀️"},
+    {"merperson", "🧜"}, {"merman", "🧜‍♂️"}, {"mermaid", "🧜‍♀️"}, {"elf", "🧝"}, {"elf_man", "🧝‍♂️"},
+    {"elf_woman", "🧝‍♀️"}, {"genie", "🧞"}, {"genie_man", "🧞‍♂️"}, {"genie_woman", "🧞‍♀️"},
+    {"zombie", "🧟"}, {"zombie_man", "🧟‍♂️"}, {"zombie_woman", "🧟‍♀️"}, {"troll", "🧌"},
+    {"massage", "💆"}, {"massage_man", "💆‍♂️"}, {"massage_woman", "💆‍♀️"}, {"haircut", "💇"},
+    {"haircut_man", "💇‍♂️"}, {"haircut_woman", "💇‍♀️"}, {"walking", "🚶"}, {"walking_man", "🚶‍♂️"},
+    {"walking_woman", "🚶‍♀️"}, {"standing_person", "🧍"}, {"standing_man", "🧍‍♂️"},
+    {"standing_woman", "🧍‍♀️"}, {"kneeling_person", "🧎"}, {"kneeling_man", "🧎‍♂️"},
+    {"kneeling_woman", "🧎‍♀️"}, {"person_with_probing_cane", "🧑‍🦯"},
+    {"man_with_probing_cane", "👨‍🦯"}, {"woman_with_probing_cane", "👩‍🦯"},
+    {"person_in_motorized_wheelchair", "🧑‍🦼"}, {"man_in_motorized_wheelchair", "👨‍🦼"},
+    {"woman_in_motorized_wheelchair", "👩‍🦼"}, {"person_in_manual_wheelchair", "🧑‍🦽"},
+    {"man_in_manual_wheelchair", "👨‍🦽"}, {"woman_in_manual_wheelchair", "👩‍🦽"}, {"runner", "🏃"},
+    {"running", "🏃"}, {"running_man", "🏃‍♂️"}, {"running_woman", "🏃‍♀️"}, {"dancer", "💃"},
+    {"woman_dancing", "💃"}, {"man_dancing", "🕺"}, {"business_suit_levitating", "🕴️"},
+    {"dancers", "👯"}, {"dancing_men", "👯‍♂️"}, {"dancing_women", "👯‍♀️"}, {"sauna_person", "🧖"},
+    {"sauna_man", "🧖‍♂️"}, {"sauna_woman", "🧖‍♀️"}, {"climbing", "🧗"}, {"climbing_man", "🧗‍♂️"},
+    {"climbing_woman", "🧗‍♀️"}, {"person_fencing", "🤺"}, {"horse_racing", "🏇"}, {"skier", "⛷️"},
+    {"snowboarder", "🏂"}, {"golfing", "🏌️"}, {"golfing_man", "🏌️‍♂️"}, {"golfing_woman", "🏌️‍♀️"},
+    {"surfer", "🏄"}, {"surfing_man", "🏄‍♂️"}, {"surfing_woman", "🏄‍♀️"}, {"rowboat", "🚣"},
+    {"rowing_man", "🚣‍♂️"}, {"rowing_woman", "🚣‍♀️"}, {"swimmer", "🏊"}, {"swimming_man", "🏊‍♂️"},
+    {"swimming_woman", "🏊‍♀️"}, {"bouncing_ball_person", "⛹️"}, {"bouncing_ball_man", "⛹️‍♂️"},
+    {"basketball_man", "⛹️‍♂️"}, {"bouncing_ball_woman", "⛹️‍♀️"}, {"basketball_woman", "⛹️‍♀️"},
+    {"weight_lifting", "🏋️"}, {"weight_lifting_man", "🏋️‍♂️"}, {"weight_lifting_woman", "🏋️‍♀️"},
+    {"bicyclist", "🚴"}, {"biking_man", "🚴‍♂️"}, {"biking_woman", "🚴‍♀️"},
+    {"mountain_bicyclist", "🚵"}, {"mountain_biking_man", "🚵‍♂️"}, {"mountain_biking_woman", "🚵‍♀️"},
+    {"cartwheeling", "🤸"}, {"man_cartwheeling", "🤸‍♂️"}, {"woman_cartwheeling", "🤸‍♀️"},
+    {"wrestling", "🤼"}, {"men_wrestling", "🤼‍♂️"}, {"women_wrestling", "🤼‍♀️"}, {"water_polo", "🤽"},
+    {"man_playing_water_polo", "🤽‍♂️"}, {"woman_playing_water_polo", "🤽‍♀️"},
+    {"handball_person", "🤾"}, {"man_playing_handball", "🤾‍♂️"}, {"woman_playing_handball", "🤾‍♀️"},
+    {"juggling_person", "🤹"}, {"man_juggling", "🤹‍♂️"}, {"woman_juggling", "🤹‍♀️"},
+    {"lotus_position", "🧘"}, {"lotus_position_man", "🧘‍♂️"}, {"lotus_position_woman", "🧘‍♀️"},
+    {"bath", "🛀"}, {"sleeping_bed", "🛌"}, {"people_holding_hands", "🧑‍🤝‍🧑"},
+    {"two_women_holding_hands", "👭"}, {"couple", "👫"}, {"two_men_holding_hands", "👬"},
+    {"couplekiss", "💏"}, {"couplekiss_man_woman", "👩‍❤️‍💋‍👨"}, {"couplekiss_man_man", "👨‍❤️‍💋‍👨"},
+    {"couplekiss_woman_woman", "👩‍❤️‍💋‍👩"}, {"couple_with_heart", "💑"},
+    {"couple_with_heart_woman_man", "👩‍❤️‍👨"}, {"couple_with_heart_man_man", "👨‍❤️‍👨"},
+    {"couple_with_heart_woman_woman", "👩‍❤️‍👩"}, {"family", "👪"}, {"family_man_woman_boy", "👨‍👩‍👦"},
+    {"family_man_woman_girl", "👨‍👩‍👧"}, {"family_man_woman_girl_boy", "👨‍👩‍👧‍👦"},
+    {"family_man_woman_boy_boy", "👨‍👩‍👦‍👦"}, {"family_man_woman_girl_girl", "👨‍👩‍👧‍👧"},
+    {"family_man_man_boy", "👨‍👨‍👦"}, {"family_man_man_girl", "👨‍👨‍👧"},
+    {"family_woman_woman_boy", "👩‍👩‍👦"}, {"family_woman_woman_girl", "👩‍👩‍👧"},
+    {"family_man_boy", "👨‍👦"}, {"family_man_girl", "👨‍👧"}, {"family_woman_boy", "👩‍👦"},
+    {"family_woman_girl", "👩‍👧"}, {"speaking_head", "🗣️"}, {"bust_in_silhouette", "👤"},
+    {"busts_in_silhouette", "👥"}, {"people_hugging", "🫂"}, {"footprints", "👣"},
+    {"monkey_face", "🐵"}, {"monkey", "🐒"}, {"gorilla", "🦍"}, {"orangutan", "🦧"}, {"dog", "🐶"},
+    {"dog2", "🐕"}, {"guide_dog", "🦮"}, {"service_dog", "🐕‍🦺"}, {"poodle", "🐩"}, {"wolf", "🐺"},
+    {"fox_face", "🦊"}, {"raccoon", "🦝"}, {"cat", "🐱"}, {"cat2", "🐈"}, {"black_cat", "🐈‍⬛"},
+    {"lion", "🦁"}, {"tiger", "🐯"}, {"tiger2", "🐅"}, {"leopard", "🐆"}, {"horse", "🐴"},
+    {"moose", "🫎"}, {"donkey", "🫏"}, {"racehorse", "🐎"}, {"unicorn", "🦄"}, {"zebra", "🦓"},
+    {"deer", "🦌"}, {"bison", "🦬"}, {"cow", "🐮"}, {"ox", "🐂"}, {"water_buffalo", "🐃"}, {"cow2", "🐄"},
+    {"pig", "🐷"}, {"pig2", "🐖"}, {"boar", "🐗"}, {"pig_nose", "🐽"}, {"ram", "🐏"}, {"sheep", "🐑"},
+    {"goat", "🐐"}, {"dromedary_camel", "🐪"}, {"camel", "🐫"}, {"llama", "🦙"}, {"giraffe", "🦒"},
+    {"elephant", "🐘"}, {"mammoth", "🦣"}, {"rhinoceros", "🦏"}, {"hippopotamus", "🦛"}, {"mouse", "🐭"},
+    {"mouse2", "🐁"}, {"rat", "🐀"}, {"hamster", "🐹"}, {"rabbit", "🐰"}, {"rabbit2", "🐇"},
+    {"chipmunk", "🐿️"}, {"beaver", "🦫"}, {"hedgehog", "🦔"}, {"bat", "🦇"}, {"bear", "🐻"},
+    {"polar_bear", "🐻‍❄️"}, {"koala", "🐨"}, {"panda_face", "🐼"}, {"sloth", "🦥"}, {"otter", "🦦"},
+    {"skunk", "🦨"}, {"kangaroo", "🦘"}, {"badger", "🦡"}, {"feet", "🐾"}, {"paw_prints", "🐾"},
+    {"turkey", "🦃"}, {"chicken", "🐔"}, {"rooster", "🐓"}, {"hatching_chick", "🐣"},
+    {"baby_chick", "🐤"}, {"hatched_chick", "🐥"}, {"bird", "🐦"}, {"penguin", "🐧"}, {"dove", "🕊️"},
+    {"eagle", "🦅"}, {"duck", "🦆"}, {"swan", "🦢"}, {"owl", "🦉"}, {"dodo", "🦤"}, {"feather", "🪶"},
+    {"flamingo", "🦩"}, {"peacock", "🦚"}, {"parrot", "🦜"}, {"wing", "🪽"}, {"black_bird", "🐦‍⬛"},
+    {"goose", "🪿"}, {"frog", "🐸"}, {"crocodile", "🐊"}, {"turtle", "🐢"}, {"lizard", "🦎"},
+    {"snake", "🐍"}, {"dragon_face", "🐲"}, {"dragon", "🐉"}, {"sauropod", "🦕"}, {"t-rex", "🦖"},
+    {"whale", "🐳"}, {"whale2", "🐋"}, {"dolphin", "🐬"}, {"flipper", "🐬"}, {"seal", "🦭"},
+    {"fish", "🐟"}, {"tropical_fish", "🐠"}, {"blowfish", "🐡"}, {"shark", "🦈"}, {"octopus", "🐙"},
+    {"shell", "🐚"}, {"coral", "🪸"}, {"jellyfish", "🪼"}, {"snail", "🐌"}, {"butterfly", "🦋"},
+    {"bug", "🐛"}, {"ant", "🐜"}, {"bee", "🐝"}, {"honeybee", "🐝"}, {"beetle", "🪲"},
+    {"lady_beetle", "🐞"}, {"cricket", "🦗"}, {"cockroach", "🪳"}, {"spider", "🕷️"},
+    {"spider_web", "🕸️"}, {"scorpion", "🦂"}, {"mosquito", "🦟"}, {"fly", "🪰"}, {"worm", "🪱"},
+    {"microbe", "🦠"}, {"bouquet", "💐"}, {"cherry_blossom", "🌸"}, {"white_flower", "💮"},
+    {"lotus", "🪷"}, {"rosette", "🏵️"}, {"rose", "🌹"}, {"wilted_flower", "🥀"}, {"hibiscus", "🌺"},
+    {"sunflower", "🌻"}, {"blossom", "🌼"}, {"tulip", "🌷"}, {"hyacinth", "🪻"}, {"seedling", "🌱"},
+    {"potted_plant", "🪴"}, {"evergreen_tree", "🌲"}, {"deciduous_tree", "🌳"}, {"palm_tree", "🌴"},
+    {"cactus", "🌵"}, {"ear_of_rice", "🌾"}, {"herb", "🌿"}, {"shamrock", "☘️"},
+    {"four_leaf_clover", "🍀"}, {"maple_leaf", "🍁"}, {"fallen_leaf", "🍂"}, {"leaves", "🍃"},
+    {"empty_nest", "🪹"}, {"nest_with_eggs", "🪺"}, {"mushroom", "🍄"}, {"grapes", "🍇"},
+    {"melon", "🍈"}, {"watermelon", "🍉"}, {"tangerine", "🍊"}, {"orange", "🍊"}, {"mandarin", "🍊"},
+    {"lemon", "🍋"}, {"banana", "🍌"}, {"pineapple", "🍍"}, {"mango", "🥭"}, {"apple", "🍎"},
+    {"green_apple", "🍏"}, {"pear", "🍐"}, {"peach", "🍑"}, {"cherries", "🍒"}, {"strawberry", "🍓"},
+    {"blueberries", "🫐"}, {"kiwi_fruit", "🥝"}, {"tomato", "🍅"}, {"olive", "🫒"}, {"coconut", "🥥"},
+    {"avocado", "🥑"}, {"eggplant", "🍆"}, {"potato", "🥔"}, {"carrot", "🥕"}, {"corn", "🌽"},
+    {"hot_pepper", "🌶️"}, {"bell_pepper", "🫑"}, {"cucumber", "🥒"}, {"leafy_green", "🥬"},
+    {"broccoli", "🥦"}, {"garlic", "🧄"}, {"onion", "🧅"}, {"peanuts", "🥜"}, {"beans", "🫘"},
+    {"chestnut", "🌰"}, {"ginger_root", "🫚"}, {"pea_pod", "🫛"}, {"bread", "🍞"}, {"croissant", "🥐"},
+    {"baguette_bread", "🥖"}, {"flatbread", "🫓"}, {"pretzel", "🥨"}, {"bagel", "🥯"},
+    {"pancakes", "🥞"}, {"waffle", "🧇"}, {"cheese", "🧀"}, {"meat_on_bone", "🍖"},
+    {"poultry_leg", "🍗"}, {"cut_of_meat", "🥩"}, {"bacon", "🥓"}, {"hamburger", "🍔"}, {"fries", "🍟"},
+    {"pizza", "🍕"}, {"hotdog", "🌭"}, {"sandwich", "🥪"}, {"taco", "🌮"}, {"burrito", "🌯"},
+    {"tamale", "🫔"}, {"stuffed_flatbread", "🥙"}, {"falafel", "🧆"}, {"egg", "🥚"}, {"fried_egg", "🍳"},
+    {"shallow_pan_of_food", "🥘"}, {"stew", "🍲"}, {"fondue", "🫕"}, {"bowl_with_spoon", "🥣"},
+    {"green_salad", "🥗"}, {"popcorn", "🍿"}, {"butter", "🧈"}, {"salt", "🧂"}, {"canned_food", "🥫"},
+    {"bento", "🍱"}, {"rice_cracker", "🍘"}, {"rice_ball", "🍙"}, {"rice", "🍚"}, {"curry", "🍛"},
+    {"ramen", "🍜"}, {"spaghetti", "🍝"}, {"sweet_potato", "🍠"}, {"oden", "🍢"}, {"sushi", "🍣"},
+    {"fried_shrimp", "🍤"}, {"fish_cake", "🍥"}, {"moon_cake", "🥮"}, {"dango", "🍡"},
+    {"dumpling", "🥟"}, {"fortune_cookie", "🥠"}, {"takeout_box", "🥡"}, {"crab", "🦀"},
+    {"lobster", "🦞"}, {"shrimp", "🦐"}, {"squid", "🦑"}, {"oyster", "🦪"}, {"icecream", "🍦"},
+    {"shaved_ice", "🍧"}, {"ice_cream", "🍨"}, {"doughnut", "🍩"}, {"cookie", "🍪"}, {"birthday", "🎂"},
+    {"cake", "🍰"}, {"cupcake", "🧁"}, {"pie", "🥧"}, {"chocolate_bar", "🍫"}, {"candy", "🍬"},
+    {"lollipop", "🍭"}, {"custard", "🍮"}, {"honey_pot", "🍯"}, {"baby_bottle", "🍼"},
+    {"milk_glass", "🥛"}, {"coffee", "☕"}, {"teapot", "🫖"}, {"tea", "🍵"}, {"sake", "🍶"},
+    {"champagne", "🍾"}, {"wine_glass", "🍷"}, {"cocktail", "🍸"}, {"tropical_drink", "🍹"},
+    {"beer", "🍺"}, {"beers", "🍻"}, {"clinking_glasses", "🥂"}, {"tumbler_glass", "🥃"},
+    {"pouring_liquid", "🫗"}, {"cup_with_straw", "🥤"}, {"bubble_tea", "🧋"}, {"beverage_box", "🧃"},
+    {"mate", "🧉"}, {"ice_cube", "🧊"}, {"chopsticks", "🥢"}, {"plate_with_cutlery", "🍽️"},
+    {"fork_and_knife", "🍴"}, {"spoon", "🥄"}, {"hocho", "🔪"}, {"knife", "🔪"}, {"jar", "🫙"},
+    {"amphora", "🏺"}, {"earth_africa", "🌍"}, {"earth_americas", "🌎"}, {"earth_asia", "🌏"},
+    {"globe_with_meridians", "🌐"}, {"world_map", "🗺️"}, {"japan", "🗾"}, {"compass", "🧭"},
+    {"mountain_snow", "🏔️"}, {"mountain", "⛰️"}, {"volcano", "🌋"}, {"mount_fuji", "🗻"},
+    {"camping", "🏕️"}, {"beach_umbrella", "🏖️"}, {"desert", "🏜️"}, {"desert_island", "🏝️"},
+    {"national_park", "🏞️"}, {"stadium", "🏟️"}, {"classical_building", "🏛️"},
+    {"building_construction", "🏗️"}, {"bricks", "🧱"}, {"rock", "🪨"}, {"wood", "🪵"}, {"hut", "🛖"},
+    {"houses", "🏘️"}, {"derelict_house", "🏚️"}, {"house", "🏠"}, {"house_with_garden", "🏡"},
+    {"office", "🏢"}, {"post_office", "🏣"}, {"european_post_office", "🏤"}, {"hospital", "🏥"},
+    {"bank", "🏦"}, {"hotel", "🏨"}, {"love_hotel", "🏩"}, {"convenience_store", "🏪"}, {"school", "🏫"},
+    {"department_store", "🏬"}, {"factory", "🏭"}, {"japanese_castle", "🏯"}, {"european_castle", "🏰"},
+    {"wedding", "💒"}, {"tokyo_tower", "🗼"}, {"statue_of_liberty", "🗽"}, {"church", "⛪"},
+    {"mosque", "🕌"}, {"hindu_temple", "🛕"}, {"synagogue", "🕍"}, {"shinto_shrine", "⛩️"},
+    {"kaaba", "🕋"}, {"fountain", "⛲"}, {"tent", "⛺"}, {"foggy", "🌁"}, {"night_with_stars", "🌃"},
+    {"cityscape", "🏙️"}, {"sunrise_over_mountains", "🌄"}, {"sunrise", "🌅"}, {"city_sunset", "🌆"},
+    {"city_sunrise", "🌇"}, {"bridge_at_night", "🌉"}, {"hotsprings", "♨️"}, {"carousel_horse", "🎠"},
+    {"playground_slide", "🛝"}, {"ferris_wheel", "🎡"}, {"roller_coaster", "🎢"}, {"barber", "💈"},
+    {"circus_tent", "🎪"}, {"steam_locomotive", "🚂"}, {"railway_car", "🚃"},
+    {"bullettrain_side", "🚄"}, {"bullettrain_front", "🚅"}, {"train2", "🚆"}, {"metro", "🚇"},
+    {"light_rail", "🚈"}, {"station", "🚉"}, {"tram", "🚊"}, {"monorail", "🚝"},
+    {"mountain_railway", "🚞"}, {"train", "🚋"}, {"bus", "🚌"}, {"oncoming_bus", "🚍"},
+    {"trolleybus", "🚎"}, {"minibus", "🚐"}, {"ambulance", "🚑"}, {"fire_engine", "🚒"},
+    {"police_car", "🚓"}, {"oncoming_police_car", "🚔"}, {"taxi", "🚕"}, {"oncoming_taxi", "🚖"},
+    {"car", "🚗"}, {"red_car", "🚗"}, {"oncoming_automobile", "🚘"}, {"blue_car", "🚙"},
+    {"pickup_truck", "🛻"}, {"truck", "🚚"}, {"articulated_lorry", "🚛"}, {"tractor", "🚜"},
+    {"racing_car", "🏎️"}, {"motorcycle", "🏍️"}, {"motor_scooter", "🛵"}, {"manual_wheelchair", "🦽"},
+    {"motorized_wheelchair", "🦼"}, {"auto_rickshaw", "🛺"}, {"bike", "🚲"}, {"kick_scooter", "🛴"},
+    {"skateboard", "🛹"}, {"roller_skate", "🛼"}, {"busstop", "🚏"}, {"motorway", "🛣️"},
+    {"railway_track", "🛤️"}, {"oil_drum", "🛢️"}, {"fuelpump", "⛽"}, {"wheel", "🛞"},
+    {"rotating_light", "🚨"}, {"traffic_light", "🚥"}, {"vertical_traffic_light", "🚦"},
+    {"stop_sign", "🛑"}, {"construction", "🚧"}, {"anchor", "⚓"}, {"ring_buoy", "🛟"}, {"boat", "⛵"},
+    {"sailboat", "⛵"}, {"canoe", "🛶"}, {"speedboat", "🚤"}, {"passenger_ship", "🛳️"},
+    {"ferry", "⛴️"}, {"motor_boat", "🛥️"}, {"ship", "🚢"}, {"airplane", "✈️"},
+    {"small_airplane", "🛩️"}, {"flight_departure", "🛫"}, {"flight_arrival", "🛬"},
+    {"parachute", "🪂"}, {"seat", "💺"}, {"helicopter", "🚁"}, {"suspension_railway", "🚟"},
+    {"mountain_cableway", "🚠"}, {"aerial_tramway", "🚡"}, {"artificial_satellite", "🛰️"},
+    {"rocket", "🚀"}, {"flying_saucer", "🛸"}, {"bellhop_bell", "🛎️"}, {"luggage", "🧳"},
+    {"hourglass", "⌛"}, {"hourglass_flowing_sand", "⏳"}, {"watch", "⌚"}, {"alarm_clock", "⏰"},
+    {"stopwatch", "⏱️"}, {"timer_clock", "⏲️"}, {"mantelpiece_clock", "🕰️"}, {"clock12", "🕛"},
+    {"clock1230", "🕧"}, {"clock1", "🕐"}, {"clock130", "🕜"}, {"clock2", "🕑"}, {"clock230", "🕝"},
+    {"clock3", "🕒"}, {"clock330", "🕞"}, {"clock4", "🕓"}, {"clock430", "🕟"}, {"clock5", "🕔"},
+    {"clock530", "🕠"}, {"clock6", "🕕"}, {"clock630", "🕡"}, {"clock7", "🕖"}, {"clock730", "🕢"},
+    {"clock8", "🕗"}, {"clock830", "🕣"}, {"clock9", "🕘"}, {"clock930", "🕤"}, {"clock10", "🕙"},
+    {"clock1030", "🕥"}, {"clock11", "🕚"}, {"clock1130", "🕦"}, {"new_moon", "🌑"},
+    {"waxing_crescent_moon", "🌒"}, {"first_quarter_moon", "🌓"}, {"moon", "🌔"},
+    {"waxing_gibbous_moon", "🌔"}, {"full_moon", "🌕"}, {"waning_gibbous_moon", "🌖"},
+    {"last_quarter_moon", "🌗"}, {"waning_crescent_moon", "🌘"}, {"crescent_moon", "🌙"},
+    {"new_moon_with_face", "🌚"}, {"first_quarter_moon_with_face", "🌛"},
+    {"last_quarter_moon_with_face", "🌜"}, {"thermometer", "🌡️"}, {"sunny", "☀️"},
+    {"full_moon_with_face", "🌝"}, {"sun_with_face", "🌞"}, {"ringed_planet", "🪐"}, {"star", "⭐"},
+    {"star2", "🌟"}, {"stars", "🌠"}, {"milky_way", "🌌"}, {"cloud", "☁️"}, {"partly_sunny", "⛅"},
+    {"cloud_with_lightning_and_rain", "⛈️"}, {"sun_behind_small_cloud", "🌤️"},
+    {"sun_behind_large_cloud", "🌥️"}, {"sun_behind_rain_cloud", "🌦️"}, {"cloud_with_rain", "🌧️"},
+    {"cloud_with_snow", "🌨️"}, {"cloud_with_lightning", "🌩️"}, {"tornado", "🌪️"}, {"fog", "🌫️"},
+    {"wind_face", "🌬️"}, {"cyclone", "🌀"}, {"rainbow", "🌈"}, {"closed_umbrella", "🌂"},
+    {"open_umbrella", "☂️"}, {"umbrella", "☔"}, {"parasol_on_ground", "⛱️"}, {"zap", "⚡"},
+    {"snowflake", "❄️"}, {"snowman_with_snow", "☃️"}, {"snowman", "⛄"}, {"comet", "☄️"},
+    {"fire", "🔥"}, {"droplet", "💧"}, {"ocean", "🌊"}, {"jack_o_lantern", "🎃"},
+    {"christmas_tree", "🎄"}, {"fireworks", "🎆"}, {"sparkler", "🎇"}, {"firecracker", "🧨"},
+    {"sparkles", "✨"}, {"balloon", "🎈"}, {"tada", "🎉"}, {"confetti_ball", "🎊"},
+    {"tanabata_tree", "🎋"}, {"bamboo", "🎍"}, {"dolls", "🎎"}, {"flags", "🎏"}, {"wind_chime", "🎐"},
+    {"rice_scene", "🎑"}, {"red_envelope", "🧧"}, {"ribbon", "🎀"}, {"gift", "🎁"},
+    {"reminder_ribbon", "🎗️"}, {"tickets", "🎟️"}, {"ticket", "🎫"}, {"medal_military", "🎖️"},
+    {"trophy", "🏆"}, {"medal_sports", "🏅"}, {"1st_place_medal", "🥇"}, {"2nd_place_medal", "🥈"},
+    {"3rd_place_medal", "🥉"}, {"soccer", "⚽"}, {"baseball", "⚾"}, {"softball", "🥎"},
+    {"basketball", "🏀"}, {"volleyball", "🏐"}, {"football", "🏈"}, {"rugby_football", "🏉"},
+    {"tennis", "🎾"}, {"flying_disc", "🥏"}, {"bowling", "🎳"}, {"cricket_game", "🏏"},
+    {"field_hockey", "🏑"}, {"ice_hockey", "🏒"}, {"lacrosse", "🥍"}, {"ping_pong", "🏓"},
+    {"badminton", "🏸"}, {"boxing_glove", "🥊"}, {"martial_arts_uniform", "🥋"}, {"goal_net", "🥅"},
+    {"golf", "⛳"}, {"ice_skate", "⛸️"}, {"fishing_pole_and_fish", "🎣"}, {"diving_mask", "🤿"},
+    {"running_shirt_with_sash", "🎽"}, {"ski", "🎿"}, {"sled", "🛷"}, {"curling_stone", "🥌"},
+    {"dart", "🎯"}, {"yo_yo", "🪀"}, {"kite", "🪁"}, {"gun", "🔫"}, {"8ball", "🎱"},
+    {"crystal_ball", "🔮"}, {"magic_wand", "🪄"}, {"video_game", "🎮"}, {"joystick", "🕹️"},
+    {"slot_machine", "🎰"}, {"game_die", "🎲"}, {"jigsaw", "🧩"}, {"teddy_bear", "🧸"}, {"pinata", "🪅"},
+    {"mirror_ball", "🪩"}, {"nesting_dolls", "🪆"}, {"spades", "♠️"}, {"hearts", "♥️"},
+    {"diamonds", "♦️"}, {"clubs", "♣️"}, {"chess_pawn", "♟️"}, {"black_joker", "🃏"},
+    {"mahjong", "🀄"}, {"flower_playing_cards", "🎴"}, {"performing_arts", "🎭"},
+    {"framed_picture", "🖼️"}, {"art", "🎨"}, {"thread", "🧵"}, {"sewing_needle", "🪡"}, {"yarn", "🧶"},
+    {"knot", "🪢"}, {"eyeglasses", "👓"}, {"dark_sunglasses", "🕶️"}, {"goggles", "🥽"},
+    {"lab_coat", "🥼"}, {"safety_vest", "🦺"}, {"necktie", "👔"}, {"shirt", "👕"}, {"tshirt", "👕"},
+    {"jeans", "👖"}, {"scarf", "🧣"}, {"gloves", "🧤"}, {"coat", "🧥"}, {"socks", "🧦"}, {"dress", "👗"},
+    {"kimono", "👘"}, {"sari", "🥻"}, {"one_piece_swimsuit", "🩱"}, {"swim_brief", "🩲"},
+    {"shorts", "🩳"}, {"bikini", "👙"}, {"womans_clothes", "👚"}, {"folding_hand_fan", "🪭"},
+    {"purse", "👛"}, {"handbag", "👜"}, {"pouch", "👝"}, {"shopping", "🛍️"}, {"school_satchel", "🎒"},
+    {"thong_sandal", "🩴"}, {"mans_shoe", "👞"}, {"shoe", "👞"}, {"athletic_shoe", "👟"},
+    {"hiking_boot", "🥾"}, {"flat_shoe", "🥿"}, {"high_heel", "👠"}, {"sandal", "👡"},
+    {"ballet_shoes", "🩰"}, {"boot", "👢"}, {"hair_pick", "🪮"}, {"crown", "👑"}, {"womans_hat", "👒"},
+    {"tophat", "🎩"}, {"mortar_board", "🎓"}, {"billed_cap", "🧢"}, {"military_helmet", "🪖"},
+    {"rescue_worker_helmet", "⛑️"}, {"prayer_beads", "📿"}, {"lipstick", "💄"}, {"ring", "💍"},
+    {"gem", "💎"}, {"mute", "🔇"}, {"speaker", "🔈"}, {"sound", "🔉"}, {"loud_sound", "🔊"},
+    {"loudspeaker", "📢"}, {"mega", "📣"}, {"postal_horn", "📯"}, {"bell", "🔔"}, {"no_bell", "🔕"},
+    {"musical_score", "🎼"}, {"musical_note", "🎵"}, {"notes", "🎶"}, {"studio_microphone", "🎙️"},
+    {"level_slider", "🎚️"}, {"control_knobs", "🎛️"}, {"microphone", "🎤"}, {"headphones", "🎧"},
+    {"radio", "📻"}, {"saxophone", "🎷"}, {"accordion", "🪗"}, {"guitar", "🎸"},
+    {"musical_keyboard", "🎹"}, {"trumpet", "🎺"}, {"violin", "🎻"}, {"banjo", "🪕"}, {"drum", "🥁"},
+    {"long_drum", "🪘"}, {"maracas", "🪇"}, {"flute", "🪈"}, {"iphone", "📱"}, {"calling", "📲"},
+    {"phone", "☎️"}, {"telephone", "☎️"}, {"telephone_receiver", "📞"}, {"pager", "📟"}, {"fax", "📠"},
+    {"battery", "🔋"}, {"low_battery", "🪫"}, {"electric_plug", "🔌"}, {"computer", "💻"},
+    {"desktop_computer", "🖥️"}, {"printer", "🖨️"}, {"keyboard", "⌨️"}, {"computer_mouse", "🖱️"},
+    {"trackball", "🖲️"}, {"minidisc", "💽"}, {"floppy_disk", "💾"}, {"cd", "💿"}, {"dvd", "📀"},
+    {"abacus", "🧮"}, {"movie_camera", "🎥"}, {"film_strip", "🎞️"}, {"film_projector", "📽️"},
+    {"clapper", "🎬"}, {"tv", "📺"}, {"camera", "📷"}, {"camera_flash", "📸"}, {"video_camera", "📹"},
+    {"vhs", "📼"}, {"mag", "🔍"}, {"mag_right", "🔎"}, {"candle", "🕯️"}, {"bulb", "💡"},
+    {"flashlight", "🔦"}, {"izakaya_lantern", "🏮"}, {"lantern", "🏮"}, {"diya_lamp", "🪔"},
+    {"notebook_with_decorative_cover", "📔"}, {"closed_book", "📕"}, {"book", "📖"},
+    {"open_book", "📖"}, {"green_book", "📗"}, {"blue_book", "📘"}, {"orange_book", "📙"},
+    {"books", "📚"}, {"notebook", "📓"}, {"ledger", "📒"}, {"page_with_curl", "📃"}, {"scroll", "📜"},
+    {"page_facing_up", "📄"}, {"newspaper", "📰"}, {"newspaper_roll", "🗞️"}, {"bookmark_tabs", "📑"},
+    {"bookmark", "🔖"}, {"label", "🏷️"}, {"moneybag", "💰"}, {"coin", "🪙"}, {"yen", "💴"},
+    {"dollar", "💵"}, {"euro", "💶"}, {"pound", "💷"}, {"money_with_wings", "💸"}, {"credit_card", "💳"},
+    {"receipt", "🧾"}, {"chart", "💹"}, {"email", "✉️"}, {"envelope", "✉️"}, {"e-mail", "📧"},
+    {"incoming_envelope", "📨"}, {"envelope_with_arrow", "📩"}, {"outbox_tray", "📤"},
+    {"inbox_tray", "📥"}, {"package", "📦"}, {"mailbox", "📫"}, {"mailbox_closed", "📪"},
+    {"mailbox_with_mail", "📬"}, {"mailbox_with_no_mail", "📭"}, {"postbox", "📮"},
+    {"ballot_box", "🗳️"}, {"pencil2", "✏️"}, {"black_nib", "✒️"}, {"fountain_pen", "🖋️"},
+    {"pen", "🖊️"}, {"paintbrush", "🖌️"}, {"crayon", "🖍️"}, {"memo", "📝"}, {"pencil", "📝"},
+    {"briefcase", "💼"}, {"file_folder", "📁"}, {"open_file_folder", "📂"},
+    {"card_index_dividers", "🗂️"}, {"date", "📅"}, {"calendar", "📆"}, {"spiral_notepad", "🗒️"},
+    {"spiral_calendar", "🗓️"}, {"card_index", "📇"}, {"chart_with_upwards_trend", "📈"},
+    {"chart_with_downwards_trend", "📉"}, {"bar_chart", "📊"}, {"clipboard", "📋"}, {"pushpin", "📌"},
+    {"round_pushpin", "📍"}, {"paperclip", "📎"}, {"paperclips", "🖇️"}, {"straight_ruler", "📏"},
+    {"triangular_ruler", "📐"}, {"scissors", "✂️"}, {"card_file_box", "🗃️"}, {"file_cabinet", "🗄️"},
+    {"wastebasket", "🗑️"}, {"lock", "🔒"}, {"unlock", "🔓"}, {"lock_with_ink_pen", "🔏"},
+    {"closed_lock_with_key", "🔐"}, {"key", "🔑"}, {"old_key", "🗝️"}, {"hammer", "🔨"}, {"axe", "🪓"},
+    {"pick", "⛏️"}, {"hammer_and_pick", "⚒️"}, {"hammer_and_wrench", "🛠️"}, {"dagger", "🗡️"},
+    {"crossed_swords", "⚔️"}, {"bomb", "💣"}, {"boomerang", "🪃"}, {"bow_and_arrow", "🏹"},
+    {"shield", "🛡️"}, {"carpentry_saw", "🪚"}, {"wrench", "🔧"}, {"screwdriver", "🪛"},
+    {"nut_and_bolt", "🔩"}, {"gear", "⚙️"}, {"clamp", "🗜️"}, {"balance_scale", "⚖️"},
+    {"probing_cane", "🦯"}, {"link", "🔗"}, {"chains", "⛓️"}, {"hook", "🪝"}, {"toolbox", "🧰"},
+    {"magnet", "🧲"}, {"ladder", "🪜"}, {"alembic", "⚗️"}, {"test_tube", "🧪"}, {"petri_dish", "🧫"},
+    {"dna", "🧬"}, {"microscope", "🔬"}, {"telescope", "🔭"}, {"satellite", "📡"}, {"syringe", "💉"},
+    {"drop_of_blood", "🩸"}, {"pill", "💊"}, {"adhesive_bandage", "🩹"}, {"crutch", "🩼"},
+    {"stethoscope", "🩺"}, {"x_ray", "🩻"}, {"door", "🚪"}, {"elevator", "🛗"}, {"mirror", "🪞"},
+    {"window", "🪟"}, {"bed", "🛏️"}, {"couch_and_lamp", "🛋️"}, {"chair", "🪑"}, {"toilet", "🚽"},
+    {"plunger", "🪠"}, {"shower", "🚿"}, {"bathtub", "🛁"}, {"mouse_trap", "🪤"}, {"razor", "🪒"},
+    {"lotion_bottle", "🧴"}, {"safety_pin", "🧷"}, {"broom", "🧹"}, {"basket", "🧺"},
+    {"roll_of_paper", "🧻"}, {"bucket", "🪣"}, {"soap", "🧼"}, {"bubbles", "🫧"}, {"toothbrush", "🪥"},
+    {"sponge", "🧽"}, {"fire_extinguisher", "🧯"}, {"shopping_cart", "🛒"}, {"smoking", "🚬"},
+    {"coffin", "⚰️"}, {"headstone", "🪦"}, {"funeral_urn", "⚱️"}, {"nazar_amulet", "🧿"},
+    {"hamsa", "🪬"}, {"moyai", "🗿"}, {"placard", "🪧"}, {"identification_card", "🪪"}, {"atm", "🏧"},
+    {"put_litter_in_its_place", "🚮"}, {"potable_water", "🚰"}, {"wheelchair", "♿"}, {"mens", "🚹"},
+    {"womens", "🚺"}, {"restroom", "🚻"}, {"baby_symbol", "🚼"}, {"wc", "🚾"},
+    {"passport_control", "🛂"}, {"customs", "🛃"}, {"baggage_claim", "🛄"}, {"left_luggage", "🛅"},
+    {"warning", "⚠️"}, {"children_crossing", "🚸"}, {"no_entry", "⛔"}, {"no_entry_sign", "🚫"},
+    {"no_bicycles", "🚳"}, {"no_smoking", "🚭"}, {"do_not_litter", "🚯"}, {"non-potable_water", "🚱"},
+    {"no_pedestrians", "🚷"}, {"no_mobile_phones", "📵"}, {"underage", "🔞"}, {"radioactive", "☢️"},
+    {"biohazard", "☣️"}, {"arrow_up", "⬆️"}, {"arrow_upper_right", "↗️"}, {"arrow_right", "➡️"},
+    {"arrow_lower_right", "↘️"}, {"arrow_down", "⬇️"}, {"arrow_lower_left", "↙️"},
+    {"arrow_left", "⬅️"}, {"arrow_upper_left", "↖️"}, {"arrow_up_down", "↕️"},
+    {"left_right_arrow", "↔️"}, {"leftwards_arrow_with_hook", "↩️"}, {"arrow_right_hook", "↪️"},
+    {"arrow_heading_up", "⤴️"}, {"arrow_heading_down", "⤵️"}, {"arrows_clockwise", "🔃"},
+    {"arrows_counterclockwise", "🔄"}, {"back", "🔙"}, {"end", "🔚"}, {"on", "🔛"}, {"soon", "🔜"},
+    {"top", "🔝"}, {"place_of_worship", "🛐"}, {"atom_symbol", "⚛️"}, {"om", "🕉️"},
+    {"star_of_david", "✡️"}, {"wheel_of_dharma", "☸️"}, {"yin_yang", "☯️"}, {"latin_cross", "✝️"},
+    {"orthodox_cross", "☦️"}, {"star_and_crescent", "☪️"}, {"peace_symbol", "☮️"}, {"menorah", "🕎"},
+    {"six_pointed_star", "🔯"}, {"khanda", "🪯"}, {"aries", "♈"}, {"taurus", "♉"}, {"gemini", "♊"},
+    {"cancer", "♋"}, {"leo", "♌"}, {"virgo", "♍"}, {"libra", "♎"}, {"scorpius", "♏"},
+    {"sagittarius", "♐"}, {"capricorn", "♑"}, {"aquarius", "♒"}, {"pisces", "♓"},
+    {"ophiuchus", "⛎"}, {"twisted_rightwards_arrows", "🔀"}, {"repeat", "🔁"}, {"repeat_one", "🔂"},
+    {"arrow_forward", "▶️"}, {"fast_forward", "⏩"}, {"next_track_button", "⏭️"},
+    {"play_or_pause_button", "⏯️"}, {"arrow_backward", "◀️"}, {"rewind", "⏪"},
+    {"previous_track_button", "⏮️"}, {"arrow_up_small", "🔼"}, {"arrow_double_up", "⏫"},
+    {"arrow_down_small", "🔽"}, {"arrow_double_down", "⏬"}, {"pause_button", "⏸️"},
+    {"stop_button", "⏹️"}, {"record_button", "⏺️"}, {"eject_button", "⏏️"}, {"cinema", "🎦"},
+    {"low_brightness", "🔅"}, {"high_brightness", "🔆"}, {"signal_strength", "📶"}, {"wireless", "🛜"},
+    {"vibration_mode", "📳"}, {"mobile_phone_off", "📴"}, {"female_sign", "♀️"}, {"male_sign", "♂️"},
+    {"transgender_symbol", "⚧️"}, {"heavy_multiplication_x", "✖️"}, {"heavy_plus_sign", "➕"},
+    {"heavy_minus_sign", "➖"}, {"heavy_division_sign", "➗"}, {"heavy_equals_sign", "🟰"},
+    {"infinity", "♾️"}, {"bangbang", "‼️"}, {"interrobang", "⁉️"}, {"question", "❓"},
+    {"grey_question", "❔"}, {"grey_exclamation", "❕"}, {"exclamation", "❗"},
+    {"heavy_exclamation_mark", "❗"}, {"wavy_dash", "〰️"}, {"currency_exchange", "💱"},
+    {"heavy_dollar_sign", "💲"}, {"medical_symbol", "⚕️"}, {"recycle", "♻️"}, {"fleur_de_lis", "⚜️"},
+    {"trident", "🔱"}, {"name_badge", "📛"}, {"beginner", "🔰"}, {"o", "⭕"}, {"white_check_mark", "✅"},
+    {"ballot_box_with_check", "☑️"}, {"heavy_check_mark", "✔️"}, {"x", "❌"},
+    {"negative_squared_cross_mark", "❎"}, {"curly_loop", "➰"}, {"loop", "➿"},
+    {"part_alternation_mark", "〽️"}, {"eight_spoked_asterisk", "✳️"},
+    {"eight_pointed_black_star", "✴️"}, {"sparkle", "❇️"}, {"copyright", "©️"},
+    {"registered", "®️"}, {"tm", "™️"}, {"hash", "#️⃣"}, {"asterisk", "*️⃣"}, {"zero", "0️⃣"},
+    {"one", "1️⃣"}, {"two", "2️⃣"}, {"three", "3️⃣"}, {"four", "4️⃣"}, {"five", "5️⃣"},
+    {"six", "6️⃣"}, {"seven", "7️⃣"}, {"eight", "8️⃣"}, {"nine", "9️⃣"}, {"keycap_ten", "🔟"},
+    {"capital_abcd", "🔠"}, {"abcd", "🔡"}, {"1234", "🔢"}, {"symbols", "🔣"}, {"abc", "🔤"},
+    {"a", "🅰️"}, {"ab", "🆎"}, {"b", "🅱️"}, {"cl", "🆑"}, {"free", "🆓"}, {"information_source", "ℹ️"},
+    {"id", "🆔"}, {"m", "Ⓜ️"}, {"new", "🆕"}, {"ng", "🆖"}, {"o2", "🅾️"}, {"ok", "🆗"},
+    {"parking", "🅿️"}, {"sos", "🆘"}, {"up", "🆙"}, {"vs", "🆚"}, {"koko", "🈁"}, {"sa", "🈂️"},
+    {"u6708", "🈷️"}, {"u6709", "🈶"}, {"u6307", "🈯"}, {"ideograph_advantage", "🉐"}, {"u5272", "🈹"},
+    {"u7121", "🈚"}, {"u7981", "🈲"}, {"accept", "🉑"}, {"u7533", "🈸"}, {"u5408", "🈴"}, {"u7a7a", "🈳"},
+    {"congratulations", "㊗️"}, {"secret", "㊙️"}, {"u55b6", "🈺"}, {"u6e80", "🈵"},
+    {"red_circle", "🔴"}, {"orange_circle", "🟠"}, {"yellow_circle", "🟡"}, {"green_circle", "🟢"},
+    {"large_blue_circle", "🔵"}, {"purple_circle", "🟣"}, {"brown_circle", "🟤"},
+    {"black_circle", "⚫"}, {"white_circle", "⚪"}, {"red_square", "🟥"}, {"orange_square", "🟧"},
+    {"yellow_square", "🟨"}, {"green_square", "🟩"}, {"blue_square", "🟦"}, {"purple_square", "🟪"},
+    {"brown_square", "🟫"}, {"black_large_square", "⬛"}, {"white_large_square", "⬜"},
+    {"black_medium_square", "◼️"}, {"white_medium_square", "◻️"},
+    {"black_medium_small_square", "◾"}, {"white_medium_small_square", "◽"},
+    {"black_small_square", "▪️"}, {"white_small_square", "▫️"}, {"large_orange_diamond", "🔶"},
+    {"large_blue_diamond", "🔷"}, {"small_orange_diamond", "🔸"}, {"small_blue_diamond", "🔹"},
+    {"small_red_triangle", "🔺"}, {"small_red_triangle_down", "🔻"},
+    {"diamond_shape_with_a_dot_inside", "💠"}, {"radio_button", "🔘"}, {"white_square_button", "🔳"},
+    {"black_square_button", "🔲"}, {"checkered_flag", "🏁"}, {"triangular_flag_on_post", "🚩"},
+    {"crossed_flags", "🎌"}, {"black_flag", "🏴"}, {"white_flag", "🏳️"}, {"rainbow_flag", "🏳️‍🌈"},
+    {"transgender_flag", "🏳️‍⚧️"}, {"pirate_flag", "🏴‍☠️"}, {"ascension_island", "🇦🇨"},
+    {"andorra", "🇦🇩"}, {"united_arab_emirates", "🇦🇪"}, {"afghanistan", "🇦🇫"},
+    {"antigua_barbuda", "🇦🇬"}, {"anguilla", "🇦🇮"}, {"albania", "🇦🇱"}, {"armenia", "🇦🇲"},
+    {"angola", "🇦🇴"}, {"antarctica", "🇦🇶"}, {"argentina", "🇦🇷"}, {"american_samoa", "🇦🇸"},
+    {"austria", "🇦🇹"}, {"australia", "🇦🇺"}, {"aruba", "🇦🇼"}, {"aland_islands", "🇦🇽"},
+    {"azerbaijan", "🇦🇿"}, {"bosnia_herzegovina", "🇧🇦"}, {"barbados", "🇧🇧"}, {"bangladesh", "🇧🇩"},
+    {"belgium", "🇧🇪"}, {"burkina_faso", "🇧🇫"}, {"bulgaria", "🇧🇬"}, {"bahrain", "🇧🇭"},
+    {"burundi", "🇧🇮"}, {"benin", "🇧🇯"}, {"st_barthelemy", "🇧🇱"}, {"bermuda", "🇧🇲"},
+    {"brunei", "🇧🇳"}, {"bolivia", "🇧🇴"}, {"caribbean_netherlands", "🇧🇶"}, {"brazil", "🇧🇷"},
+    {"bahamas", "🇧🇸"}, {"bhutan", "🇧🇹"}, {"bouvet_island", "🇧🇻"}, {"botswana", "🇧🇼"},
+    {"belarus", "🇧🇾"}, {"belize", "🇧🇿"}, {"canada", "🇨🇦"}, {"cocos_islands", "🇨🇨"},
+    {"congo_kinshasa", "🇨🇩"}, {"central_african_republic", "🇨🇫"}, {"congo_brazzaville", "🇨🇬"},
+    {"switzerland", "🇨🇭"}, {"cote_divoire", "🇨🇮"}, {"cook_islands", "🇨🇰"}, {"chile", "🇨🇱"},
+    {"cameroon", "🇨🇲"}, {"cn", "🇨🇳"}, {"colombia", "🇨🇴"}, {"clipperton_island", "🇨🇵"},
+    {"costa_rica", "🇨🇷"}, {"cuba", "🇨🇺"}, {"cape_verde", "🇨🇻"}, {"curacao", "🇨🇼"},
+    {"christmas_island", "🇨🇽"}, {"cyprus", "🇨🇾"}, {"czech_republic", "🇨🇿"}, {"de", "🇩🇪"},
+    {"diego_garcia", "🇩🇬"}, {"djibouti", "🇩🇯"}, {"denmark", "🇩🇰"}, {"dominica", "🇩🇲"},
+    {"dominican_republic", "🇩🇴"}, {"algeria", "🇩🇿"}, {"ceuta_melilla", "🇪🇦"}, {"ecuador", "🇪🇨"},
+    {"estonia", "🇪🇪"}, {"egypt", "🇪🇬"}, {"western_sahara", "🇪🇭"}, {"eritrea", "🇪🇷"}, {"es", "🇪🇸"},
+    {"ethiopia", "🇪🇹"}, {"eu", "🇪🇺"}, {"european_union", "🇪🇺"}, {"finland", "🇫🇮"}, {"fiji", "🇫🇯"},
+    {"falkland_islands", "🇫🇰"}, {"micronesia", "🇫🇲"}, {"faroe_islands", "🇫🇴"}, {"fr", "🇫🇷"},
+    {"gabon", "🇬🇦"}, {"gb", "🇬🇧"}, {"uk", "🇬🇧"}, {"grenada", "🇬🇩"}, {"georgia", "🇬🇪"},
+    {"french_guiana", "🇬🇫"}, {"guernsey", "🇬🇬"}, {"ghana", "🇬🇭"}, {"gibraltar", "🇬🇮"},
+    {"greenland", "🇬🇱"}, {"gambia", "🇬🇲"}, {"guinea", "🇬🇳"}, {"guadeloupe", "🇬🇵"},
+    {"equatorial_guinea", "🇬🇶"}, {"greece", "🇬🇷"}, {"south_georgia_south_sandwich_islands", "🇬🇸"},
+    {"guatemala", "🇬🇹"}, {"guam", "🇬🇺"}, {"guinea_bissau", "🇬🇼"}, {"guyana", "🇬🇾"},
+    {"hong_kong", "🇭🇰"}, {"heard_mcdonald_islands", "🇭🇲"}, {"honduras", "🇭🇳"}, {"croatia", "🇭🇷"},
+    {"haiti", "🇭🇹"}, {"hungary", "🇭🇺"}, {"canary_islands", "🇮🇨"}, {"indonesia", "🇮🇩"},
+    {"ireland", "🇮🇪"}, {"israel", "🇮🇱"}, {"isle_of_man", "🇮🇲"}, {"india", "🇮🇳"},
+    {"british_indian_ocean_territory", "🇮🇴"}, {"iraq", "🇮🇶"}, {"iran", "🇮🇷"}, {"iceland", "🇮🇸"},
+    {"it", "🇮🇹"}, {"jersey", "🇯🇪"}, {"jamaica", "🇯🇲"}, {"jordan", "🇯🇴"}, {"jp", "🇯🇵"},
+    {"kenya", "🇰🇪"}, {"kyrgyzstan", "🇰🇬"}, {"cambodia", "🇰🇭"}, {"kiribati", "🇰🇮"},
+    {"comoros", "🇰🇲"}, {"st_kitts_nevis", "🇰🇳"}, {"north_korea", "🇰🇵"}, {"kr", "🇰🇷"},
+    {"kuwait", "🇰🇼"}, {"cayman_islands", "🇰🇾"}, {"kazakhstan", "🇰🇿"}, {"laos", "🇱🇦"},
+    {"lebanon", "🇱🇧"}, {"st_lucia", "🇱🇨"}, {"liechtenstein", "🇱🇮"}, {"sri_lanka", "🇱🇰"},
+    {"liberia", "🇱🇷"}, {"lesotho", "🇱🇸"}, {"lithuania", "🇱🇹"}, {"luxembourg", "🇱🇺"},
+    {"latvia", "🇱🇻"}, {"libya", "🇱🇾"}, {"morocco", "🇲🇦"}, {"monaco", "🇲🇨"}, {"moldova", "🇲🇩"},
+    {"montenegro", "🇲🇪"}, {"st_martin", "🇲🇫"}, {"madagascar", "🇲🇬"}, {"marshall_islands", "🇲🇭"},
+    {"macedonia", "🇲🇰"}, {"mali", "🇲🇱"}, {"myanmar", "🇲🇲"}, {"mongolia", "🇲🇳"}, {"macau", "🇲🇴"},
+    {"northern_mariana_islands", "🇲🇵"}, {"martinique", "🇲🇶"}, {"mauritania", "🇲🇷"},
+    {"montserrat", "🇲🇸"}, {"malta", "🇲🇹"}, {"mauritius", "🇲🇺"}, {"maldives", "🇲🇻"},
+    {"malawi", "🇲🇼"}, {"mexico", "🇲🇽"}, {"malaysia", "🇲🇾"}, {"mozambique", "🇲🇿"}, {"namibia", "🇳🇦"},
+    {"new_caledonia", "🇳🇨"}, {"niger", "🇳🇪"}, {"norfolk_island", "🇳🇫"}, {"nigeria", "🇳🇬"},
+    {"nicaragua", "🇳🇮"}, {"netherlands", "🇳🇱"}, {"norway", "🇳🇴"}, {"nepal", "🇳🇵"}, {"nauru", "🇳🇷"},
+    {"niue", "🇳🇺"}, {"new_zealand", "🇳🇿"}, {"oman", "🇴🇲"}, {"panama", "🇵🇦"}, {"peru", "🇵🇪"},
+    {"french_polynesia", "🇵🇫"}, {"papua_new_guinea", "🇵🇬"}, {"philippines", "🇵🇭"},
+    {"pakistan", "🇵🇰"}, {"poland", "🇵🇱"}, {"st_pierre_miquelon", "🇵🇲"}, {"pitcairn_islands", "🇵🇳"},
+    {"puerto_rico", "🇵🇷"}, {"palestinian_territories", "🇵🇸"}, {"portugal", "🇵🇹"}, {"palau", "🇵🇼"},
+    {"paraguay", "🇵🇾"}, {"qatar", "🇶🇦"}, {"reunion", "🇷🇪"}, {"romania", "🇷🇴"}, {"serbia", "🇷🇸"},
+    {"ru", "🇷🇺"}, {"rwanda", "🇷🇼"}, {"saudi_arabia", "🇸🇦"}, {"solomon_islands", "🇸🇧"},
+    {"seychelles", "🇸🇨"}, {"sudan", "🇸🇩"}, {"sweden", "🇸🇪"}, {"singapore", "🇸🇬"},
+    {"st_helena", "🇸🇭"}, {"slovenia", "🇸🇮"}, {"svalbard_jan_mayen", "🇸🇯"}, {"slovakia", "🇸🇰"},
+    {"sierra_leone", "🇸🇱"}, {"san_marino", "🇸🇲"}, {"senegal", "🇸🇳"}, {"somalia", "🇸🇴"},
+    {"suriname", "🇸🇷"}, {"south_sudan", "🇸🇸"}, {"sao_tome_principe", "🇸🇹"}, {"el_salvador", "🇸🇻"},
+    {"sint_maarten", "🇸🇽"}, {"syria", "🇸🇾"}, {"swaziland", "🇸🇿"}, {"tristan_da_cunha", "🇹🇦"},
+    {"turks_caicos_islands", "🇹🇨"}, {"chad", "🇹🇩"}, {"french_southern_territories", "🇹🇫"},
+    {"togo", "🇹🇬"}, {"thailand", "🇹🇭"}, {"tajikistan", "🇹🇯"}, {"tokelau", "🇹🇰"},
+    {"timor_leste", "🇹🇱"}, {"turkmenistan", "🇹🇲"}, {"tunisia", "🇹🇳"}, {"tonga", "🇹🇴"}, {"tr", "🇹🇷"},
+    {"trinidad_tobago", "🇹🇹"}, {"tuvalu", "🇹🇻"}, {"taiwan", "🇹🇼"}, {"tanzania", "🇹🇿"},
+    {"ukraine", "🇺🇦"}, {"uganda", "🇺🇬"}, {"us_outlying_islands", "🇺🇲"}, {"united_nations", "🇺🇳"},
+    {"us", "🇺🇸"}, {"uruguay", "🇺🇾"}, {"uzbekistan", "🇺🇿"}, {"vatican_city", "🇻🇦"},
+    {"st_vincent_grenadines", "🇻🇨"}, {"venezuela", "🇻🇪"}, {"british_virgin_islands", "🇻🇬"},
+    {"us_virgin_islands", "🇻🇮"}, {"vietnam", "🇻🇳"}, {"vanuatu", "🇻🇺"}, {"wallis_futuna", "🇼🇫"},
+    {"samoa", "🇼🇸"}, {"kosovo", "🇽🇰"}, {"yemen", "🇾🇪"}, {"mayotte", "🇾🇹"}, {"south_africa", "🇿🇦"},
+    {"zambia", "🇿🇲"}, {"zimbabwe", "🇿🇼"}, {"england", "🏴󠁧󠁢󠁥󠁮󠁧󠁿"}, {"scotland", "🏴󠁧󠁢󠁳󠁣󠁴󠁿"},
+    {"wales", "🏴󠁧󠁢󠁷󠁬󠁳󠁿"},
+    // md2html names that predate the GitHub set (:smile: and :cool: keep
+    // their original meaning here rather than GitHub's 😄 and 🆒)
+    {"smile", "😊"}, {"laugh", "😂"}, {"check", "✅"}, {"info", "ℹ️"}, {"cool", "😎"},
+};
 
-        string content = trim(line.substr(level));
-        string id = generateId(content);
+static constexpr size_t emojiCount = sizeof(emojiEntries) / sizeof(emojiEntries[0]);
+
+// Power of two, kept at least four times the entry count so probe runs stay short
+static constexpr size_t emojiSlotCount = 8192;
+
+constexpr size_t constLength(const char *s)
+{
+    size_t n = 0;
+    while (s[n] != '\0')
+        n++;
+    return n;
+}
 
-        // Add to TOC
-        tocEntries.push_back({level, id, content});
+constexpr bool constEqual(const char *a, const char *b)
+{
+    size_t i = 0;
+    while (a[i] != '\0' && a[i] == b[i])
+        i++;
+    return a[i] == b[i];
+}
 
-        return "<h" + to_string(level) + " id=\"" + id + "\">" + processInlineFormatting(content) + "</h" + to_string(level) + ">";
+// FNV-1a with a final avalanche so the low bits used for the slot are mixed
+constexpr uint32_t fnv1aHash(const char *s, size_t n)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++)
+    {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 16777619u;
     }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    return h;
+}
+
+struct EmojiTable
+{
+    uint16_t slots[emojiSlotCount]; // index into emojiEntries + 1, 0 when empty
+    size_t longestName;
+    size_t longestProbe;
+    bool duplicates;
+};
 
-    void closeAllLists(string &html)
+constexpr EmojiTable buildEmojiTable()
+{
+    EmojiTable table{};
+    for (size_t i = 0; i < emojiCount; i++)
     {
-        while (listDepth > 0)
+        size_t len = constLength(emojiEntries[i].name);
+        size_t slot = fnv1aHash(emojiEntries[i].name, len) & (emojiSlotCount - 1);
+        size_t probe = 1;
+        while (table.slots[slot] != 0)
         {
-            if (inList)
-            {
-                html += "</ul>\n";
-                inList = false;
-            }
-            if (inOrderedList)
-            {
-                html += "</ol>\n";
-                inOrderedList = false;
-            }
-            listDepth--;
+            if (constEqual(emojiEntries[table.slots[slot] - 1].name, emojiEntries[i].name))
+                table.duplicates = true;
+            slot = (slot + 1) & (emojiSlotCount - 1);
+            probe++;
         }
+        table.slots[slot] = static_cast<uint16_t>(i + 1);
+        if (len > table.longestName)
+            table.longestName = len;
+        if (probe > table.longestProbe)
+            table.longestProbe = probe;
     }
+    return table;
+}
+
+static constexpr EmojiTable emojiTable = buildEmojiTable();
+static_assert(emojiCount * 4 <= emojiSlotCount, "emoji table is too full");
+static_assert(!emojiTable.duplicates, "duplicate emoji shortcode");
+static_assert(emojiTable.longestProbe <= 6, "emoji hash clusters too much");
+
+// Emoji for a shortcode name given without its colons, or nullptr.
+static const char *lookupEmoji(const char *name, size_t len)
+{
+    if (len == 0 || len > emojiTable.longestName)
+        return nullptr;
 
-    bool isOrderedListItem(const string &line)
+    size_t slot = fnv1aHash(name, len) & (emojiSlotCount - 1);
+    while (emojiTable.slots[slot] != 0)
     {
-        if (line.empty())
-            return false;
-        size_t i = 0;
-        while (i < line.length() && isdigit(line[i]))
-            i++;
-        return i > 0 && i < line.length() && line[i] == '.' && i + 1 < line.length() && line[i + 1] == ' ';
+        const EmojiEntry &entry = emojiEntries[emojiTable.slots[slot] - 1];
+        if (strncmp(entry.name, name, len) == 0 && entry.name[len] == '\0')
+            return entry.emoji;
+        slot = (slot + 1) & (emojiSlotCount - 1);
     }
+    return nullptr;
+}
 
-    string generateTOC()
-    {
-        if (tocEntries.empty())
-            return "";
+// ---------------------------------------------------------------------------
+// Syntax highlighting
+//
+// Fenced code in a language listed here is tokenized during rendering and
+// written with Highlight.js class names, so the page needs no script to
+// colour it. A language is one row of a table (its word lists, comment and
+// string delimiters and a few flags) and one lexer walks any of them. It
+// goes a line at a time and carries what can span lines (block comments
+// and multi-line strings) from one line to the next.
+// ---------------------------------------------------------------------------
 
-        string toc = "<div class=\"toc\">\n<h2>Table of Contents</h2>\n<ul>\n";
+enum class TokenClass : uint8_t
+{
+    Plain,
+    Keyword,
+    Type,
+    BuiltIn,
+    Literal,
+    Number,
+    String,
+    Comment,
+    Meta,
+    Variable,
+    Attribute
+};
 
-        for (const auto &entry : tocEntries)
-        {
-            string indent(entry.level - 1, ' ');
-            toc += indent + "  <li><a href=\"#" + entry.id + "\">" + entry.text + "</a></li>\n";
-        }
+static const char *const tokenClassNames[] = {"", "hljs-keyword", "hljs-type", "hljs-built_in", "hljs-literal",
+                                              "hljs-number", "hljs-string", "hljs-comment", "hljs-meta",
+                                              "hljs-variable", "hljs-attr"};
 
-        toc += "</ul>\n</div>\n\n";
-        return toc;
-    }
+enum SyntaxFlag : unsigned
+{
+    SyntaxPreprocessor = 1 << 0,   // A line starting with '#' is a directive
+    SyntaxTripleQuotes = 1 << 1,   // """ and ''' strings, which span lines
+    SyntaxVariables = 1 << 2,      // $name, ${name} and $1
+    SyntaxDollarWords = 1 << 3,    // '$' can be part of a name
+    SyntaxDecorators = 1 << 4,     // @name
+    SyntaxIgnoreCase = 1 << 5,     // Words match the lists in any case
+    SyntaxQuotedKeys = 1 << 6,     // A string followed by ':' is a key
+    SyntaxLineKeys = 1 << 7,       // "key:" at the start of a line, and --- markers
+    SyntaxSpacedComments = 1 << 8, // The line comment only starts after a space
+    SyntaxBareWords = 1 << 9       // Arguments such as c++17 are words: a number stands alone
+};
 
-    string generateFootnotes()
+struct LanguageSyntax
+{
+    const char *names; // Info strings that select the language, space separated
+    const char *keywords;
+    const char *types;
+    const char *builtIns;
+    const char *literals;
+    const char *lineComment; // Or nullptr, as are the block delimiters
+    const char *blockOpen;
+    const char *blockClose;
+    const char *quotes;          // Characters that open a string
+    const char *multilineQuotes; // Of those, the ones whose strings can span lines
+    unsigned flags;
+};
+
+static const LanguageSyntax languageSyntaxes[] = {
+    {"c cpp c++ cc cxx h hpp hxx",
+     "alignas alignof asm auto break case catch class const consteval constexpr constinit const_cast continue "
+     "co_await co_return co_yield decltype default delete do dynamic_cast else enum explicit export extern final "
+     "for friend goto if inline mutable namespace new noexcept operator override private protected public register "
+     "reinterpret_cast return sizeof static static_assert static_cast struct switch template this thread_local "
+     "throw try typedef typeid typename union using virtual volatile while",
+     "bool char char8_t char16_t char32_t double float int long short signed unsigned void wchar_t size_t ssize_t "
+     "ptrdiff_t int8_t int16_t int32_t int64_t uint8_t uint16_t uint32_t uint64_t intptr_t uintptr_t",
+     "std string string_view vector map unordered_map set array unique_ptr shared_ptr cout cerr endl printf malloc free",
+     "true false nullptr NULL",
+     "//", "/*", "*/", "\"'", "", SyntaxPreprocessor},
+    {"python py python3",
+     "and as assert async await break class continue def del elif else except finally for from global if import "
+     "in is lambda nonlocal not or pass raise return try while with yield match case",
+     "",
+     "int float str bool list dict set tuple bytes object type len range print open super self isinstance "
+     "enumerate zip map filter sorted min max sum any all",
+     "True False None",
+     "#", nullptr, nullptr, "\"'", "", SyntaxTripleQuotes | SyntaxDecorators},
+    {"javascript js jsx mjs typescript ts tsx",
+     "as async await break case catch class const continue debugger default delete do else enum export extends "
+     "finally for from function get if implements import in instanceof interface let new of private protected "
+     "public readonly return set static super switch this throw try type typeof var void while with yield "
+     "abstract declare keyof namespace",
+     "string number boolean any unknown never object symbol bigint",
+     "Array Object Promise Map Set JSON Math console document window",
+     "true false null undefined NaN Infinity",
+     "//", "/*", "*/", "\"'`", "`", SyntaxDollarWords | SyntaxDecorators},
+    {"bash sh shell zsh console",
+     "if then else elif fi case esac for select while until do done in function time return exit break continue "
+     "local export readonly declare set unset shift source alias",
+     "",
+     "echo printf read cd pwd test eval exec trap wait kill cat grep sed awk ls mkdir rm cp mv chmod sudo",
+     "true false",
+     "#", nullptr, nullptr, "\"'", "\"'", SyntaxVariables | SyntaxSpacedComments | SyntaxBareWords},
+    {"json jsonc",
+     "", "", "",
+     "true false null",
+     "//", "/*", "*/", "\"", "", SyntaxQuotedKeys},
+    {"yaml yml",
+     "", "", "",
+     "true false null yes no on off",
+     "#", nullptr, nullptr, "\"'", "", SyntaxLineKeys | SyntaxQuotedKeys | SyntaxSpacedComments},
+    {"sql mysql postgresql psql sqlite",
+     "select from where and or not in is as join left right inner outer full cross on group by order having limit "
+     "offset insert into values update set delete create table index view drop alter add column primary key foreign "
+     "references unique default constraint distinct union all exists between like case when then else end begin "
+     "commit rollback transaction with returning asc desc if",
+     "int integer bigint smallint varchar char text boolean date time timestamp numeric decimal float real double "
+     "serial blob",
+     "count sum avg min max coalesce now",
+     "null true false",
+     "--", "/*", "*/", "'\"", "'", SyntaxIgnoreCase},
+};
+
+static const size_t languageSyntaxCount = sizeof(languageSyntaxes) / sizeof(languageSyntaxes[0]);
+
+// A language's word lists in one open-addressed table keyed by fnv1aHash.
+// Slots are at least four times the word count, a power of two.
+class KeywordTable
+{
+private:
+    struct Slot
     {
-        if (footnotes.empty())
-            return "";
+        string_view word;
+        TokenClass type = TokenClass::Plain;
+    };
 
-        string result = "\n<div class=\"footnotes\">\n<hr>\n<ol>\n";
+    vector<Slot> slots;
 
-        for (const auto &note : footnotes)
+    template <typename Fn>
+    static void forEachWord(const char *list, Fn fn)
+    {
+        string_view words(list);
+        while (!words.empty())
         {
-            result += "<li id=\"fn" + note.first + "\">" + processInlineFormatting(note.second) +
-                      " <a href=\"#fnref" + note.first + "\" class=\"footnote-backref\">↩</a></li>\n";
+            size_t space = words.find(' ');
+            string_view word = words.substr(0, space);
+            if (!word.empty())
+                fn(word);
+            words = space == string_view::npos ? string_view() : words.substr(space + 1);
         }
-
-        result += "</ol>\n</div>\n";
-        return result;
     }
 
 public:
-    MarkdownConverter()
+    explicit KeywordTable(const LanguageSyntax &syntax)
     {
-        initializeEmojiMap();
+        const pair<const char *, TokenClass> lists[] = {{syntax.keywords, TokenClass::Keyword},
+                                                        {syntax.types, TokenClass::Type},
+                                                        {syntax.builtIns, TokenClass::BuiltIn},
+                                                        {syntax.literals, TokenClass::Literal}};
+        size_t count = 0;
+        for (const auto &list : lists)
+            forEachWord(list.first, [&](string_view)
+                        { count++; });
+        size_t size = 16;
+        while (size < count * 4)
+            size *= 2;
+        slots.resize(size);
+        for (const auto &list : lists)
+        {
+            forEachWord(list.first, [&](string_view word)
+                        {
+                            size_t slot = fnv1aHash(word.data(), word.length()) & (slots.size() - 1);
+                            while (slots[slot].type != TokenClass::Plain && slots[slot].word != word)
+                                slot = (slot + 1) & (slots.size() - 1);
+                            if (slots[slot].type == TokenClass::Plain)
+                                slots[slot] = {word, list.second}; });
+        }
     }
 
-    string convertToHTML(const string &markdown)
+    TokenClass find(string_view word) const
     {
-        string html;
-        istringstream iss(markdown);
-        string line;
-        vector<string> lines;
-
-        // First pass: collect all lines and extract footnotes
-        while (iss.good() && getline(iss, line))
+        size_t slot = fnv1aHash(word.data(), word.length()) & (slots.size() - 1);
+        for (; slots[slot].type != TokenClass::Plain; slot = (slot + 1) & (slots.size() - 1))
         {
-            // Check for footnote definitions
-            try
-            {
-                if (line.length() > 3 && line[0] == '[' && line[1] == '^')
-                {
-                    size_t closeBracket = line.find("]:");
-                    if (closeBracket != string::npos && closeBracket > 2)
-                    {
-                        string footnoteId = line.substr(2, closeBracket - 2);
-                        string footnoteText = line.substr(closeBracket + 2);
-                        footnotes[footnoteId] = trim(footnoteText);
-                        continue;
-                    }
-                }
-            }
-            catch (const exception &e)
-            {
-                cerr << "Error processing footnote definition: " << e.what() << endl;
-            }
-            lines.push_back(line);
+            if (slots[slot].word == word)
+                return slots[slot].type;
         }
+        return TokenClass::Plain;
+    }
+};
 
-        // Second pass: process markdown
-        for (size_t i = 0; i < lines.size(); i++)
-        {
-            line = trim(lines[i]);
+struct Language
+{
+    const LanguageSyntax &syntax;
+    KeywordTable words;
+    CharTable starts; // Characters a token can start with
+};
 
-            // Empty lines
-            if (line.empty())
-            {
-                closeAllLists(html);
-                if (inTable)
-                {
-                    html += "</table>\n";
-                    inTable = false;
-                }
-                continue;
-            }
+static string tokenStartChars(const LanguageSyntax &syntax)
+{
+    string chars = "0123456789._ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    for (int c = 0x80; c < 0x100; c++)
+        chars += static_cast<char>(c);
+    chars += syntax.quotes;
+    for (const char *delimiter : {syntax.lineComment, syntax.blockOpen})
+    {
+        if (delimiter != nullptr)
+            chars += delimiter[0];
+    }
+    if (syntax.flags & (SyntaxVariables | SyntaxDollarWords))
+        chars += '$';
+    if (syntax.flags & SyntaxDecorators)
+        chars += '@';
+    return chars;
+}
 
-            // Code blocks
-            if (line.substr(0, 3) == "```")
+// The language a fence's info string names ("cpp", "{.python}",
+// "js title=x"), or nullptr for none and for languages not listed.
+static const Language *findLanguage(string_view info)
+{
+    static const vector<Language> languages = []
+    {
+        vector<Language> all;
+        for (const LanguageSyntax &syntax : languageSyntaxes)
+            all.push_back({syntax, KeywordTable(syntax), CharTable(tokenStartChars(syntax).c_str())});
+        return all;
+    }();
+
+    size_t start = info.find_first_not_of(" \t{.");
+    if (start == string_view::npos)
+        return nullptr;
+    size_t end = info.find_first_of(" \t}", start);
+    string_view name = info.substr(start, end == string_view::npos ? string_view::npos : end - start);
+    char lower[16];
+    if (name.length() > sizeof(lower))
+        return nullptr;
+    for (size_t i = 0; i < name.length(); i++)
+        lower[i] = static_cast<char>(tolower(static_cast<unsigned char>(name[i])));
+    name = string_view(lower, name.length());
+
+    for (const Language &language : languages)
+    {
+        string_view names(language.syntax.names);
+        for (size_t pos = 0; pos <= names.length();)
+        {
+            size_t space = names.find(' ', pos);
+            if (space == string_view::npos)
+                space = names.length();
+            if (names.substr(pos, space - pos) == name)
+                return &language;
+            pos = space + 1;
+        }
+    }
+    return nullptr;
+}
+
+// What is still open at the end of a line
+struct HighlightState
+{
+    TokenClass open = TokenClass::Plain; // Comment or String, or Plain for nothing
+    char quote = 0;
+    bool triple = false;
+};
+
+// Writes one line of code as HTML with its tokens in spans.
+class LineHighlighter
+{
+private:
+    const Language &language;
+    const LanguageSyntax &syntax;
+    string_view line;
+    HighlightState &state;
+    string &html;
+    size_t plainFrom = 0; // Start of the text not yet written
+
+    bool isWordStart(unsigned char c) const
+    {
+        return isalpha(c) || c == '_' || c >= 0x80 || (c == '$' && (syntax.flags & SyntaxDollarWords));
+    }
+
+    bool isWordChar(unsigned char c) const
+    {
+        return isWordStart(c) || isdigit(c);
+    }
+
+    static bool inSet(const char *set, char c)
+    {
+        return c != '\0' && strchr(set, c) != nullptr;
+    }
+
+    bool startsWith(size_t i, const char *text) const
+    {
+        return text != nullptr && line[i] == text[0] && line.compare(i, strlen(text), text) == 0;
+    }
+
+    size_t wordEnd(size_t i) const
+    {
+        while (i < line.length() && isWordChar(static_cast<unsigned char>(line[i])))
+            i++;
+        return i;
+    }
+
+    // Writes the plain text before start, then [start, end) as a token
+    void token(size_t start, size_t end, TokenClass type)
+    {
+        if (start > plainFrom)
+            appendHtmlEscaped(html, line.data() + plainFrom, start - plainFrom);
+        if (type == TokenClass::Plain)
+            appendHtmlEscaped(html, line.data() + start, end - start);
+        else if (end > start)
+        {
+            html += "<span class=\"";
+            html += tokenClassNames[static_cast<int>(type)];
+            html += "\">";
+            appendHtmlEscaped(html, line.data() + start, end - start);
+            html += "</span>";
+        }
+        plainFrom = end;
+    }
+
+    // End of a string whose body starts at i; sets closed when the closing
+    // quote is on this line
+    size_t stringEnd(size_t i, char quote, bool triple, bool &closed) const
+    {
+        for (; i < line.length(); i++)
+        {
+            if (line[i] == '\\')
+                i++;
+            else if (line[i] == quote &&
+                     (!triple || (i + 2 < line.length() && line[i + 1] == quote && line[i + 2] == quote)))
             {
-                closeAllLists(html);
-                if (inTable)
-                {
-                    html += "</table>\n";
-                    inTable = false;
-                }
-                if (!inCodeBlock)
-                {
-                    string lang = line.length() > 3 ? line.substr(3) : "";
-                    html += "<pre><code" + (lang.empty() ? "" : " class=\"language-" + lang + "\"") + ">";
-                    inCodeBlock = true;
-                }
-                else
-                {
-                    html += "</code></pre>\n";
-                    inCodeBlock = false;
-                }
-                continue;
+                closed = true;
+                return i + (triple ? 3 : 1);
             }
+        }
+        closed = false;
+        return line.length();
+    }
 
-            // Inside code block
-            if (inCodeBlock)
+    // Continues a comment or string left open by the line before
+    size_t resume()
+    {
+        TokenClass type = state.open;
+        size_t end = line.length();
+        if (state.open == TokenClass::Comment)
+        {
+            size_t close = line.find(syntax.blockClose);
+            if (close != string_view::npos)
             {
-                html += escapeHtml(line) + "\n";
-                continue;
+                end = close + strlen(syntax.blockClose);
+                state.open = TokenClass::Plain;
             }
+        }
+        else
+        {
+            bool closed;
+            end = stringEnd(0, state.quote, state.triple, closed);
+            if (closed)
+                state.open = TokenClass::Plain;
+        }
+        token(0, end, type);
+        return end;
+    }
 
-            // Table detection
-            if (line.find('|') != string::npos && !inTable)
+    // YAML's "key:" and "- key:" at the start of a line, and its --- and
+    // ... document markers; returns where lexing goes on
+    size_t lineKey()
+    {
+        if (line.substr(0, 3) == "---" || line.substr(0, 3) == "...")
+        {
+            token(0, line.length(), TokenClass::Meta);
+            return line.length();
+        }
+        size_t k = line.find_first_not_of(' ');
+        if (k != string_view::npos && line.compare(k, 2, "- ") == 0)
+            k = line.find_first_not_of(' ', k + 2);
+        if (k == string_view::npos || line[k] == '#' || inSet(syntax.quotes, line[k]))
+            return 0;
+        for (size_t j = k; j < line.length(); j++)
+        {
+            if (line[j] == ':' && (j + 1 == line.length() || line[j + 1] == ' '))
             {
-                // Check if this might be a table
-                if (i + 1 < lines.size() && isTableSeparator(lines[i + 1]))
-                {
-                    closeAllLists(html);
-                    html += "<table>\n<thead>\n<tr>";
+                token(k, j, TokenClass::Attribute);
+                return j;
+            }
+            if (line[j] == '#' && line[j - 1] == ' ')
+                break;
+        }
+        return 0;
+    }
 
-                    vector<string> headers = parseTableRow(line);
-                    for (const string &header : headers)
-                    {
-                        html += "<th>" + processInlineFormatting(header) + "</th>";
-                    }
-                    html += "</tr>\n</thead>\n<tbody>\n";
-                    inTable = true;
-                    i++; // Skip separator line
-                    continue;
-                }
+public:
+    LineHighlighter(const Language &lang, string_view text, HighlightState &lineState, string &out)
+        : language(lang), syntax(lang.syntax), line(text), state(lineState), html(out) {}
+
+    void run()
+    {
+        const size_t n = line.length();
+        size_t i = state.open != TokenClass::Plain ? resume() : 0;
+        if (i == 0 && (syntax.flags & SyntaxPreprocessor))
+        {
+            size_t first = line.find_first_not_of(" \t");
+            if (first != string_view::npos && line[first] == '#')
+            {
+                token(first, n, TokenClass::Meta);
+                i = n;
             }
+        }
+        if (i == 0 && (syntax.flags & SyntaxLineKeys))
+            i = lineKey();
 
-            // Table rows
-            if (inTable && line.find('|') != string::npos)
+        while (i < n)
+        {
+            unsigned char c = static_cast<unsigned char>(line[i]);
+            if (!language.starts[line[i]])
             {
-                html += "<tr>";
-                vector<string> cells = parseTableRow(line);
-                for (const string &cell : cells)
-                {
-                    html += "<td>" + processInlineFormatting(cell) + "</td>";
-                }
-                html += "</tr>\n";
+                i++;
                 continue;
             }
-            else if (inTable)
+            if (startsWith(i, syntax.lineComment) &&
+                (!(syntax.flags & SyntaxSpacedComments) || i == 0 || line[i - 1] == ' ' || line[i - 1] == '\t'))
             {
-                html += "</tbody>\n</table>\n";
-                inTable = false;
+                token(i, n, TokenClass::Comment);
+                break;
             }
-
-            // Headings
-            if (line[0] == '#')
+            if (startsWith(i, syntax.blockOpen))
             {
-                closeAllLists(html);
-                html += processHeading(line) + "\n";
+                size_t close = line.find(syntax.blockClose, i + strlen(syntax.blockOpen));
+                size_t end = close == string_view::npos ? n : close + strlen(syntax.blockClose);
+                if (close == string_view::npos)
+                    state.open = TokenClass::Comment;
+                token(i, end, TokenClass::Comment);
+                i = end;
             }
-            // Horizontal rule
-            else if (line == "---" || line == "***" || line == "___")
+            else if (inSet(syntax.quotes, line[i]))
             {
-                closeAllLists(html);
-                html += "<hr>\n";
+                char quote = static_cast<char>(c);
+                bool triple = (syntax.flags & SyntaxTripleQuotes) && i + 2 < n && line[i + 1] == quote && line[i + 2] == quote;
+                bool closed;
+                size_t end = stringEnd(i + (triple ? 3 : 1), quote, triple, closed);
+                if (!closed && (triple || inSet(syntax.multilineQuotes, quote)))
+                    state = {TokenClass::String, quote, triple};
+                TokenClass type = TokenClass::String;
+                if (closed && (syntax.flags & SyntaxQuotedKeys))
+                {
+                    size_t after = line.find_first_not_of(' ', end);
+                    if (after != string_view::npos && line[after] == ':')
+                        type = TokenClass::Attribute;
+                }
+                token(i, end, type);
+                i = end;
             }
-            // Blockquotes
-            else if (line[0] == '>')
+            else if (isdigit(c) || (c == '.' && i + 1 < n && isdigit(static_cast<unsigned char>(line[i + 1]))))
             {
-                closeAllLists(html);
-                string content = trim(line.substr(1));
-                html += "<blockquote><p>" + processInlineFormatting(content) + "</p></blockquote>\n";
+                size_t end = i + 1;
+                while (end < n && (isalnum(static_cast<unsigned char>(line[end])) || line[end] == '.' || line[end] == '_' ||
+                                   ((line[end] == '+' || line[end] == '-') && inSet("eEpP", line[end - 1]))))
+                    end++;
+                bool alone = !(syntax.flags & SyntaxBareWords) ||
+                             ((i == 0 || inSet(" \t=([,", line[i - 1])) && (end == n || inSet(" \t;)],", line[end])));
+                if (alone)
+                    token(i, end, TokenClass::Number);
+                i = end;
             }
-            // Task lists
-            else if ((line.substr(0, 6) == "- [x] " || line.substr(0, 6) == "- [X] " || line.substr(0, 6) == "- [ ] "))
+            else if (isWordStart(c))
             {
-                if (!inList)
+                size_t end = wordEnd(i + 1);
+                string_view word = line.substr(i, end - i);
+                char lower[32];
+                if ((syntax.flags & SyntaxIgnoreCase) && word.length() <= sizeof(lower))
                 {
-                    html += "<ul class=\"task-list\">\n";
-                    inList = true;
-                    listDepth = 1;
+                    for (size_t k = 0; k < word.length(); k++)
+                        lower[k] = static_cast<char>(tolower(static_cast<unsigned char>(word[k])));
+                    word = string_view(lower, word.length());
                 }
-                html += "  " + processTaskList(line) + "\n";
+                TokenClass type = language.words.find(word);
+                if (type != TokenClass::Plain)
+                    token(i, end, type);
+                i = end;
             }
-            // Regular lists with nesting support
-            else if (line[0] == '-' || line[0] == '*' || line[0] == '+')
+            else if (c == '$' && (syntax.flags & SyntaxVariables) && i + 1 < n)
             {
-                int currentIndent = getIndentLevel(line);
-
-                if (currentIndent > listDepth)
+                size_t end = i + 1;
+                if (line[end] == '{')
                 {
-                    html += "<ul>\n";
-                    listDepth = currentIndent;
-                    inList = true;
-                }
-                else if (currentIndent < listDepth)
-                {
-                    while (listDepth > currentIndent)
-                    {
-                        html += "</ul>\n";
-                        listDepth--;
-                    }
+                    size_t close = line.find('}', end);
+                    end = close == string_view::npos ? n : close + 1;
                 }
+                else if (isWordStart(static_cast<unsigned char>(line[end])))
+                    end = wordEnd(end);
+                else if (isdigit(static_cast<unsigned char>(line[end])) || inSet("?#@*!$-", line[end]))
+                    end++;
+                if (end > i + 1)
+                    token(i, end, TokenClass::Variable);
+                i = end;
+            }
+            else if (c == '@' && (syntax.flags & SyntaxDecorators) && i + 1 < n &&
+                     isWordStart(static_cast<unsigned char>(line[i + 1])))
+            {
+                size_t end = wordEnd(i + 1);
+                while (end + 1 < n && line[end] == '.' && isWordStart(static_cast<unsigned char>(line[end + 1])))
+                    end = wordEnd(end + 1);
+                token(i, end, TokenClass::Meta);
+                i = end;
+            }
+            else
+                i++;
+        }
+        token(n, n, TokenClass::Plain);
+    }
+};
 
-                if (!inList)
-                {
-                    html += "<ul>\n";
-                    inList = true;
-                    listDepth = max(1, currentIndent);
-                }
+// ---------------------------------------------------------------------------
+// Document tree
+//
+// Parsing builds a tree of block and inline nodes; HtmlRenderer walks it to
+// produce HTML. Nodes are carved out of an Arena and are never freed one by
+// one: the whole tree goes away when the arena is reset.
+// ---------------------------------------------------------------------------
+
+// Bump allocator. Memory is handed out from 64 KB blocks that are kept across
+// reset(), so a converter that is reused stops allocating once warmed up.
+// Only trivially destructible types can live here.
+class Arena
+{
+private:
+    struct Block
+    {
+        unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    static constexpr size_t blockSize = 64 * 1024;
+    vector<Block> blocks;
+    size_t current = 0;
+    size_t used = 0;
+    size_t bytes = 0;
+
+public:
+    void *allocate(size_t size, size_t align)
+    {
+        size_t offset = (used + align - 1) & ~(align - 1);
+        while (current >= blocks.size() || offset + size > blocks[current].size)
+        {
+            if (current < blocks.size())
+                current++;
+            if (current == blocks.size())
+            {
+                size_t newSize = max(blockSize, size);
+                blocks.push_back({unique_ptr<char[]>(new char[newSize]), newSize});
+            }
+            offset = 0;
+        }
+        used = offset + size;
+        bytes += size;
+        return blocks[current].data.get() + offset;
+    }
+
+    template <typename T>
+    T *make()
+    {
+        static_assert(is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T();
+    }
+
+    string_view copy(string_view text)
+    {
+        if (text.empty())
+            return {};
+        char *p = static_cast<char *>(allocate(text.length(), 1));
+        memcpy(p, text.data(), text.length());
+        return string_view(p, text.length());
+    }
+
+    // Releases everything allocated so far; the blocks are kept for reuse.
+    void reset()
+    {
+        current = 0;
+        used = 0;
+        bytes = 0;
+    }
+
+    // Releases everything, then frees the blocks past the first keepBytes
+    // so one large document does not pin its memory for good.
+    void trim(size_t keepBytes)
+    {
+        reset();
+        size_t kept = 0, count = 0;
+        while (count < blocks.size() && kept + blocks[count].size <= keepBytes)
+            kept += blocks[count++].size;
+        blocks.resize(count);
+    }
+
+    size_t bytesUsed() const { return bytes; }
+};
 
-                string content = trim(line.substr(1));
-                html += "  <li>" + processInlineFormatting(content) + "</li>\n";
+enum class InlineType : uint8_t
+{
+    Text,
+    Code,
+    MathInline,
+    MathBlock,
+    Image,
+    Link,
+    Autolink,
+    FootnoteRef,
+    Emoji,
+    Emphasis,
+    Strong,
+    Strikethrough
+};
+
+// Text, code and math hold the raw source text, escaped when rendered. An
+// image keeps its alt text in text; an emoji holds the UTF-8 character.
+struct InlineNode
+{
+    InlineType type = InlineType::Text;
+    string_view text;
+    string_view url;
+    InlineNode *firstChild = nullptr;
+    InlineNode *next = nullptr;
+};
+
+struct InlineList
+{
+    InlineNode *first = nullptr;
+    InlineNode *last = nullptr;
+
+    void append(InlineNode *node)
+    {
+        if (last != nullptr)
+            last->next = node;
+        else
+            first = node;
+        last = node;
+    }
+};
+
+enum class BlockType : uint8_t
+{
+    Paragraph,
+    Heading,
+    ThematicBreak,
+    Blockquote,
+    CodeBlock,
+    CodeLine,
+    Table,
+    TableRow,
+    TableCell,
+    List,
+    ListItem
+};
+
+enum class TaskState : uint8_t
+{
+    None,
+    Open,
+    Done
+};
+
+// Set per column by the delimiter row: ":--", ":-:" or "--:"
+enum class TableAlign : uint8_t
+{
+    None,
+    Left,
+    Center,
+    Right
+};
+
+static const char *const tableAlignNames[] = {"", "left", "center", "right"};
+
+struct BlockNode;
+
+struct BlockList
+{
+    BlockNode *first = nullptr;
+    BlockNode *last = nullptr;
+
+    void append(BlockNode *node);
+};
+
+struct BlockNode
+{
+    BlockType type = BlockType::Paragraph;
+    uint8_t level = 0;         // Heading level
+    bool ordered = false;      // List: <ol> rather than <ul>
+    bool header = false;       // TableRow: part of <thead>; Table: head written by an earlier streaming flush
+    bool plain = false;        // Paragraph, TableCell: text has no markup and is copied as is
+    TaskState task = TaskState::None;
+    TableAlign align = TableAlign::None; // TableCell
+    string_view text;          // Raw text of a paragraph, heading, code line or plain cell; code info string
+    string_view id;            // Heading anchor
+    InlineNode *inlines = nullptr;
+    BlockList children;
+    BlockNode *next = nullptr;
+};
+
+inline void BlockList::append(BlockNode *node)
+{
+    if (last != nullptr)
+        last->next = node;
+    else
+        first = node;
+    last = node;
+}
+
+// Turns a document tree into HTML. Holds no state of its own.
+class HtmlRenderer
+{
+public:
+    void renderBlocks(const BlockNode *block, string &html) const
+    {
+        for (; block != nullptr; block = block->next)
+            renderBlock(*block, html);
+    }
+
+    void renderInlines(const InlineNode *node, string &html) const
+    {
+        for (; node != nullptr; node = node->next)
+        {
+            switch (node->type)
+            {
+            case InlineType::Text:
+                appendHtmlEscaped(html, node->text.data(), node->text.length());
+                break;
+            case InlineType::Code:
+                html += "<code>";
+                appendHtmlEscaped(html, node->text.data(), node->text.length());
+                html += "</code>";
+                break;
+            case InlineType::MathInline:
+                html += "<span class=\"math-inline\">";
+                appendHtmlEscaped(html, node->text.data(), node->text.length());
+                html += "</span>";
+                break;
+            case InlineType::MathBlock:
+                html += "<div class=\"math-block\">";
+                appendHtmlEscaped(html, node->text.data(), node->text.length());
+                html += "</div>";
+                break;
+            case InlineType::Image:
+                html += "<img src=\"";
+                appendHtmlEscaped(html, node->url.data(), node->url.length(), true);
+                html += "\" alt=\"";
+                appendHtmlEscaped(html, node->text.data(), node->text.length(), true);
+                html += "\">";
+                break;
+            case InlineType::Link:
+                html += "<a href=\"";
+                appendHtmlEscaped(html, node->url.data(), node->url.length(), true);
+                html += "\">";
+                renderInlines(node->firstChild, html);
+                html += "</a>";
+                break;
+            case InlineType::Autolink:
+                html += "<a href=\"";
+                appendHtmlEscaped(html, node->url.data(), node->url.length(), true);
+                html += "\">";
+                appendHtmlEscaped(html, node->url.data(), node->url.length(), true);
+                html += "</a>";
+                break;
+            case InlineType::FootnoteRef:
+                html += "<sup><a href=\"#fn";
+                appendHtmlEscaped(html, node->text.data(), node->text.length(), true);
+                html += "\" id=\"fnref";
+                appendHtmlEscaped(html, node->text.data(), node->text.length(), true);
+                html += "\">";
+                appendHtmlEscaped(html, node->text.data(), node->text.length(), true);
+                html += "</a></sup>";
+                break;
+            case InlineType::Emoji:
+                html += node->text;
+                break;
+            case InlineType::Emphasis:
+                html += "<em>";
+                renderInlines(node->firstChild, html);
+                html += "</em>";
+                break;
+            case InlineType::Strong:
+                html += "<strong>";
+                renderInlines(node->firstChild, html);
+                html += "</strong>";
+                break;
+            case InlineType::Strikethrough:
+                html += "<del>";
+                renderInlines(node->firstChild, html);
+                html += "</del>";
+                break;
+            }
+        }
+    }
+
+    // A table still being parsed is written without its closing tags
+    // (closed false); the rest follows in a node whose header flag says the
+    // head is already out.
+    void renderTable(const BlockNode &table, bool closed, string &html) const
+    {
+        const BlockNode *row = table.children.first;
+        if (!table.header)
+        {
+            html += "<table>\n<thead>\n";
+            for (; row != nullptr && row->header; row = row->next)
+                renderBlock(*row, html);
+            html += "</thead>\n<tbody>\n";
+        }
+        renderBlocks(row, html);
+        if (closed)
+            html += "</tbody>\n</table>\n";
+    }
+
+    void renderBlock(const BlockNode &block, string &html) const
+    {
+        switch (block.type)
+        {
+        case BlockType::Paragraph:
+            html += "<p>";
+            if (block.plain)
+                html += block.text;
+            else
+                renderInlines(block.inlines, html);
+            html += "</p>\n";
+            break;
+        case BlockType::Heading:
+        {
+            char level = static_cast<char>('0' + block.level);
+            html += "<h";
+            html += level;
+            html += " id=\"";
+            html += block.id;
+            html += "\">";
+            renderInlines(block.inlines, html);
+            html += "</h";
+            html += level;
+            html += ">\n";
+            break;
+        }
+        case BlockType::ThematicBreak:
+            html += "<hr>\n";
+            break;
+        case BlockType::Blockquote:
+            html += "<blockquote><p>";
+            renderInlines(block.inlines, html);
+            html += "</p></blockquote>\n";
+            break;
+        case BlockType::CodeBlock:
+        {
+            html += "<pre><code";
+            if (!block.text.empty())
+            {
+                html += " class=\"language-";
+                appendHtmlEscaped(html, block.text.data(), block.text.length(), true);
+                html += '"';
             }
-            // Ordered lists
-            else if (isOrderedListItem(line))
+            const Language *language = findLanguage(block.text);
+            // Highlight.js, when a page loads it for another block, skips this one
+            if (language != nullptr)
+                html += " data-highlighted=\"yes\"";
+            html += '>';
+            if (language != nullptr)
             {
-                closeAllLists(html);
-                if (!inOrderedList)
+                HighlightState state;
+                for (const BlockNode *line = block.children.first; line != nullptr; line = line->next)
                 {
-                    html += "<ol>\n";
-                    inOrderedList = true;
-                    listDepth = 1;
+                    LineHighlighter(*language, line->text, state, html).run();
+                    html += '\n';
                 }
-                size_t dotPos = line.find(". ");
-                string content = trim(line.substr(dotPos + 2));
-                html += "  <li>" + processInlineFormatting(content) + "</li>\n";
             }
-            // Paragraph
             else
             {
-                closeAllLists(html);
-                if (inTable)
+                for (const BlockNode *line = block.children.first; line != nullptr; line = line->next)
                 {
-                    html += "</tbody>\n</table>\n";
-                    inTable = false;
+                    appendHtmlEscaped(html, line->text.data(), line->text.length());
+                    html += '\n';
                 }
-                html += "<p>" + processInlineFormatting(line) + "</p>\n";
             }
+            html += "</code></pre>\n";
+            break;
         }
-
-        // Clean up any open tags
-        closeAllLists(html);
-        if (inTable)
+        case BlockType::Table:
         {
-            html += "</tbody>\n</table>\n";
+            renderTable(block, true, html);
+            break;
         }
-        if (inCodeBlock)
-        {
-            html += "</code></pre>\n";
-            inCodeBlock = false;
+        case BlockType::TableRow:
+            html += "<tr>";
+            for (const BlockNode *cell = block.children.first; cell != nullptr; cell = cell->next)
+            {
+                html += block.header ? "<th" : "<td";
+                if (cell->align != TableAlign::None)
+                {
+                    html += " align=\"";
+                    html += tableAlignNames[static_cast<int>(cell->align)];
+                    html += '"';
+                }
+                html += '>';
+                if (cell->plain)
+                    html += cell->text;
+                else
+                    renderInlines(cell->inlines, html);
+                html += block.header ? "</th>" : "</td>";
+            }
+            html += "</tr>\n";
+            break;
+        case BlockType::List:
+            if (block.ordered)
+                html += "<ol>\n";
+            else if (block.task != TaskState::None)
+                html += "<ul class=\"task-list\">\n";
+            else
+                html += "<ul>\n";
+            renderBlocks(block.children.first, html);
+            html += block.ordered ? "</ol>\n" : "</ul>\n";
+            break;
+        case BlockType::ListItem:
+            if (block.task == TaskState::Done)
+                html += "  <li class=\"task-item\"><input type=\"checkbox\" checked disabled> ";
+            else if (block.task == TaskState::Open)
+                html += "  <li class=\"task-item\"><input type=\"checkbox\" disabled> ";
+            else
+                html += "  <li>";
+            renderInlines(block.inlines, html);
+            if (block.children.first != nullptr)
+            {
+                html += '\n';
+                renderBlocks(block.children.first, html);
+                html += "  ";
+            }
+            html += "</li>\n";
+            break;
+        case BlockType::CodeLine:
+        case BlockType::TableCell:
+            // Rendered by their parent
+            break;
         }
-
-        // Add TOC at the beginning
-        string toc = generateTOC();
-
-        // Add footnotes at the end
-        string footnotesHtml = generateFootnotes();
-
-        return toc + html + footnotesHtml;
     }
 };
 
-bool fileExists(const string &filename)
+// A converted page as a list of segments to be written out in order.
+// Static text such as the page template is referenced where it lives and
+// strings handed over with append(string &&) are kept without copying, so
+// the page is never concatenated into one buffer. writeFile() sends all
+// segments with writev where available.
+class OutputBuffer
 {
-    ifstream file(filename);
-    return file.good();
-}
+private:
+    deque<string> owned; // Stable addresses as strings are added
+    vector<string_view> segments;
+    size_t total = 0;
 
-string generateHTML(const string &content, const string &title = "Converted Document")
-{
-    return "<!DOCTYPE html>\n"
-           "<html lang=\"en\">\n"
-           "<head>\n"
-           "  <meta charset=\"UTF-8\">\n"
-           "  <meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n"
-           "  <title>" +
-           title + "</title>\n"
-                   "  <link rel=\"stylesheet\" href=\"https://cdnjs.cloudflare.com/ajax/libs/highlight.js/11.9.0/styles/default.min.css\">\n"
-                   "  <script src=\"https://cdnjs.cloudflare.com/ajax/libs/highlight.js/11.9.0/highlight.min.js\"></script>\n"
-                   "  <script src=\"https://polyfill.io/v3/polyfill.min.js?features=es6\"></script>\n"
-                   "  <script id=\"MathJax-script\" async src=\"https://cdn.jsdelivr.net/npm/mathjax@3/es5/tex-mml-chtml.js\"></script>\n"
-                   "  <style>\n"
-                   "    :root {\n"
-                   "      --bg-color: #ffffff;\n"
-                   "      --text-color: #333333;\n"
-                   "      --border-color: #dddddd;\n"
-                   "      --code-bg: #f4f4f4;\n"
-                   "      --blockquote-border: #dddddd;\n"
-                   "      --table-border: #dddddd;\n"
-                   "    }\n"
-                   "    \n"
-                   "    [data-theme=\"dark\"] {\n"
-                   "      --bg-color: #1a1a1a;\n"
-                   "      --text-color: #e0e0e0;\n"
-                   "      --border-color: #444444;\n"
-                   "      --code-bg: #2d2d2d;\n"
-                   "      --blockquote-border: #555555;\n"
-                   "      --table-border: #555555;\n"
-                   "    }\n"
-                   "    \n"
-                   "    body {\n"
-                   "      font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, 'Helvetica Neue', Arial, sans-serif;\n"
-                   "      max-width: 900px;\n"
-                   "      margin: 0 auto;\n"
-                   "      padding: 20px;\n"
-                   "      line-height: 1.6;\n"
-                   "      background-color: var(--bg-color);\n"
-                   "      color: var(--text-color);\n"
-                   "      transition: background-color 0.3s, color 0.3s;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .theme-toggle {\n"
-                   "      position: fixed;\n"
-                   "      top: 20px;\n"
-                   "      right: 20px;\n"
-                   "      background: var(--code-bg);\n"
-                   "      border: 1px solid var(--border-color);\n"
-                   "      border-radius: 50px;\n"
-                   "      padding: 10px 15px;\n"
-                   "      cursor: pointer;\n"
-                   "      font-size: 16px;\n"
-                   "      transition: all 0.3s;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .theme-toggle:hover {\n"
-                   "      transform: scale(1.1);\n"
-                   "    }\n"
-                   "    \n"
-                   "    code {\n"
-                   "      background-color: var(--code-bg);\n"
-                   "      padding: 2px 6px;\n"
-                   "      border-radius: 4px;\n"
-                   "      font-family: 'SF Mono', Monaco, 'Cascadia Code', 'Roboto Mono', Consolas, 'Courier New', monospace;\n"
-                   "      font-size: 0.9em;\n"
-                   "    }\n"
-                   "    \n"
-                   "    pre {\n"
-                   "      background-color: var(--code-bg);\n"
-                   "      padding: 16px;\n"
-                   "      border-radius: 8px;\n"
-                   "      overflow-x: auto;\n"
-                   "      border: 1px solid var(--border-color);\n"
-                   "    }\n"
-                   "    \n"
-                   "    pre code {\n"
-                   "      background: none;\n"
-                   "      padding: 0;\n"
-                   "    }\n"
-                   "    \n"
-                   "    blockquote {\n"
-                   "      border-left: 4px solid var(--blockquote-border);\n"
-                   "      margin: 0;\n"
-                   "      padding-left: 20px;\n"
-                   "      color: var(--text-color);\n"
-                   "      opacity: 0.8;\n"
-                   "      font-style: italic;\n"
-                   "    }\n"
-                   "    \n"
-                   "    hr {\n"
-                   "      border: none;\n"
-                   "      border-top: 2px solid var(--border-color);\n"
-                   "      margin: 30px 0;\n"
-                   "    }\n"
-                   "    \n"
-                   "    img {\n"
-                   "      max-width: 100%;\n"
-                   "      height: auto;\n"
-                   "      border-radius: 8px;\n"
-                   "      box-shadow: 0 4px 8px rgba(0,0,0,0.1);\n"
-                   "    }\n"
-                   "    \n"
-                   "    ul, ol {\n"
-                   "      padding-left: 25px;\n"
-                   "    }\n"
-                   "    \n"
-                   "    li {\n"
-                   "      margin: 8px 0;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .task-list {\n"
-                   "      list-style: none;\n"
-                   "      padding-left: 0;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .task-item {\n"
-                   "      display: flex;\n"
-                   "      align-items: center;\n"
-                   "      margin: 8px 0;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .task-item input[type=\"checkbox\"] {\n"
-                   "      margin-right: 8px;\n"
-                   "      transform: scale(1.2);\n"
-                   "    }\n"
-                   "    \n"
-                   "    table {\n"
-                   "      width: 100%;\n"
-                   "      border-collapse: collapse;\n"
-                   "      margin: 20px 0;\n"
-                   "      border: 1px solid var(--table-border);\n"
-                   "      border-radius: 8px;\n"
-                   "      overflow: hidden;\n"
-                   "    }\n"
-                   "    \n"
-                   "    th, td {\n"
-                   "      padding: 12px 15px;\n"
-                   "      text-align: left;\n"
-                   "      border-bottom: 1px solid var(--table-border);\n"
-                   "    }\n"
-                   "    \n"
-                   "    th {\n"
-                   "      background-color: var(--code-bg);\n"
-                   "      font-weight: 600;\n"
-                   "    }\n"
-                   "    \n"
-                   "    tr:hover {\n"
-                   "      background-color: var(--code-bg);\n"
-                   "    }\n"
-                   "    \n"
-                   "    .toc {\n"
-                   "      background-color: var(--code-bg);\n"
-                   "      padding: 20px;\n"
-                   "      border-radius: 8px;\n"
-                   "      margin-bottom: 30px;\n"
-                   "      border: 1px solid var(--border-color);\n"
-                   "    }\n"
-                   "    \n"
-                   "    .toc h2 {\n"
-                   "      margin-top: 0;\n"
-                   "      color: var(--text-color);\n"
-                   "    }\n"
-                   "    \n"
-                   "    .toc ul {\n"
-                   "      list-style-type: none;\n"
-                   "      padding-left: 0;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .toc li {\n"
-                   "      margin: 5px 0;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .toc a {\n"
-                   "      text-decoration: none;\n"
-                   "      color: var(--text-color);\n"
-                   "      opacity: 0.8;\n"
-                   "      transition: opacity 0.3s;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .toc a:hover {\n"
-                   "      opacity: 1;\n"
-                   "      text-decoration: underline;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .footnotes {\n"
-                   "      margin-top: 40px;\n"
-                   "      padding-top: 20px;\n"
-                   "      border-top: 1px solid var(--border-color);\n"
-                   "    }\n"
-                   "    \n"
-                   "    .footnote-backref {\n"
-                   "      text-decoration: none;\n"
-                   "      font-size: 0.8em;\n"
-                   "      margin-left: 5px;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .math-inline {\n"
-                   "      font-family: 'Times New Roman', serif;\n"
-                   "    }\n"
-                   "    \n"
-                   "    .math-block {\n"
-                   "      text-align: center;\n"
-                   "      margin: 20px 0;\n"
-                   "      font-family: 'Times New Roman', serif;\n"
-                   "    }\n"
-                   "    \n"
-                   "    h1, h2, h3, h4, h5, h6 {\n"
-                   "      margin-top: 2em;\n"
-                   "      margin-bottom: 0.5em;\n"
-                   "      font-weight: 600;\n"
-                   "    }\n"
-                   "    \n"
-                   "    h1 { font-size: 2.2em; }\n"
-                   "    h2 { font-size: 1.8em; }\n"
-                   "    h3 { font-size: 1.5em; }\n"
-                   "    h4 { font-size: 1.3em; }\n"
-                   "    h5 { font-size: 1.1em; }\n"
-                   "    h6 { font-size: 1em; }\n"
-                   "    \n"
-                   "    a {\n"
-                   "      color: #0066cc;\n"
-                   "      text-decoration: none;\n"
-                   "    }\n"
-                   "    \n"
-                   "    a:hover {\n"
-                   "      text-decoration: underline;\n"
-                   "    }\n"
-                   "    \n"
-                   "    [data-theme=\"dark\"] a {\n"
-                   "      color: #66b3ff;\n"
-                   "    }\n"
-                   "  </style>\n"
-                   "</head>\n"
-                   "<body>\n"
-                   "  <button class=\"theme-toggle\" onclick=\"toggleTheme()\">🌓</button>\n"
-                   "  \n" +
-           content + "\n"
-                     "  \n"
-                     "  <script>\n"
-                     "    // Initialize syntax highlighting\n"
-                     "    hljs.highlightAll();\n"
-                     "    \n"
-                     "    // Configure MathJax\n"
-                     "    window.MathJax = {\n"
-                     "      tex: {\n"
-                     "        inlineMath: [['$', '$']],\n"
-                     "        displayMath: [['$$', '$$']]\n"
-                     "      }\n"
-                     "    };\n"
-                     "    \n"
-                     "    // Dark mode toggle\n"
-                     "    function toggleTheme() {\n"
-                     "      const body = document.body;\n"
-                     "      const currentTheme = body.getAttribute('data-theme');\n"
-                     "      body.setAttribute('data-theme', currentTheme === 'dark' ? 'light' : 'dark');\n"
-                     "      localStorage.setItem('theme', body.getAttribute('data-theme'));\n"
-                     "    }\n"
-                     "    \n"
-                     "    // Persist theme across reloads\n"
-                     "    (function() {\n"
-                     "      const savedTheme = localStorage.getItem('theme') || 'light';\n"
-                     "      document.body.setAttribute('data-theme', savedTheme);\n"
-                     "    })();\n"
-                     "  </script>\n"
-                     "</body>\n"
-                     "</html>";
-}
+public:
+    // text must outlive the buffer (string literals, static templates)
+    void appendStatic(string_view text)
+    {
+        if (text.empty())
+            return;
+        segments.push_back(text);
+        total += text.length();
+    }
 
-int main(int argc, char *argv[])
-{
-    string inputFile = "input.md";
-    string outputFile = "output.html";
+    void append(string &&text)
+    {
+        if (text.empty())
+            return;
+        owned.push_back(move(text));
+        appendStatic(owned.back());
+    }
 
-    // Command line arguments
-    if (argc >= 2)
-        inputFile = argv[1];
-    if (argc >= 3)
-        outputFile = argv[2];
+    void append(string_view text)
+    {
+        append(string(text));
+    }
 
-    // Check if input file exists
-    if (!fileExists(inputFile))
+    // Adds text in front of everything appended so far
+    void prepend(string &&text)
     {
-        cerr << "Error: Input file '" << inputFile << "' not found.\n";
-        cerr << "Usage: " << argv[0] << " [input.md] [output.html]\n";
-        return 1;
+        if (text.empty())
+            return;
+        owned.push_front(move(text));
+        segments.insert(segments.begin(), string_view(owned.front()));
+        total += owned.front().length();
     }
 
-    ifstream inFile(inputFile);
-    ofstream outFile(outputFile);
+    size_t length() const { return total; }
 
-    if (!inFile.is_open())
+    // Hands every segment to write in order, stopping when it returns false
+    template <typename Write>
+    bool forEach(Write &&write) const
     {
-        cerr << "Error: Cannot open input file '" << inputFile << "'.\n";
-        return 1;
+        for (string_view segment : segments)
+        {
+            if (!write(segment))
+                return false;
+        }
+        return true;
     }
 
-    if (!outFile.is_open())
+    string str() const
     {
-        cerr << "Error: Cannot create output file '" << outputFile << "'.\n";
-        return 1;
+        string result;
+        result.reserve(total);
+        for (string_view segment : segments)
+            result += segment;
+        return result;
     }
 
-    // Read entire file
-    ostringstream buffer;
-    buffer << inFile.rdbuf();
-    string markdown = buffer.str();
-
-    // Convert markdown to HTML
-    MarkdownConverter converter;
-    string htmlContent = converter.convertToHTML(markdown);
+    bool write(ostream &out) const
+    {
+        for (string_view segment : segments)
+            out.write(segment.data(), static_cast<streamsize>(segment.length()));
+        return out.good();
+    }
 
-    // Generate complete HTML document
-    string fullHTML = generateHTML(htmlContent, "Markdown Document");
+#ifdef MD2HTML_POSIX
+    // How far a write that may stop short has got
+    struct Cursor
+    {
+        size_t index = 0;
+        size_t offset = 0; // Bytes of segments[index] already written
+    };
 
-    // Write to output file
-    outFile << fullHTML;
+    bool finished(const Cursor &cursor) const { return cursor.index == segments.size(); }
 
-    cout << "Conversion complete!\n";
-    cout << "  Input:  " << inputFile << " (" << markdown.length() << " characters)\n";
-    cout << "  Output: " << outputFile << "\n";
+    bool write(int fd) const
+    {
+        Cursor cursor;
+        return write(fd, cursor) && finished(cursor);
+    }
 
-    inFile.close();
-    outFile.close();
+    // Writes from cursor on until everything is out or a non-blocking fd
+    // would block. False on an error.
+    bool write(int fd, Cursor &cursor) const
+    {
+        const size_t maxSegments = IOV_MAX < 1024 ? IOV_MAX : 1024;
+        vector<iovec> iov;
+        size_t &index = cursor.index;
+        size_t &offset = cursor.offset;
+        while (index < segments.size())
+        {
+            iov.clear();
+            for (size_t k = index; k < segments.size() && iov.size() < maxSegments; k++)
+            {
+                string_view segment = segments[k];
+                if (k == index)
+                    segment.remove_prefix(offset);
+                iov.push_back({const_cast<char *>(segment.data()), segment.length()});
+            }
+
+            ssize_t written = writev(fd, iov.data(), static_cast<int>(iov.size()));
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return true;
+            if (written <= 0)
+                return false;
+
+            // Skip what went out; a short write resumes mid-segment
+            size_t left = static_cast<size_t>(written);
+            while (index < segments.size() && left >= segments[index].length() - offset)
+            {
+                left -= segments[index].length() - offset;
+                offset = 0;
+                index++;
+            }
+            offset += left;
+        }
+        return true;
+    }
+#endif
+
+    bool writeFile(const string &filename) const
+    {
+#ifdef MD2HTML_POSIX
+        int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        bool ok = write(fd);
+        return close(fd) == 0 && ok;
+#else
+        ofstream file(filename, ios::binary);
+        return file.is_open() && write(file);
+#endif
+    }
+};
+
+struct TocEntry
+{
+    int level;
+    string id;
+    string text;
+};
+
+// Bounds on what one document may ask of the converter. Parsing is linear
+// in the input either way; the limits cap memory and output nesting, and
+// past each one the input is still converted, only more plainly.
+struct ConverterLimits
+{
+    size_t maxLineLength = 1 << 20; // Longer lines are escaped, not parsed for inline markup
+    int maxNesting = 32;            // Deeper lists nest no further; deeper emphasis stays literal
+    size_t maxTableColumns = 256;   // Cells past the last column stay in it as text
+    size_t maxFootnotes = 10000;    // Further definitions are left as ordinary lines
+};
+
+// Page features that need third-party scripts; the page template loads
+// them only for documents that use them
+enum PageFeature : unsigned
+{
+    FeatureCode = 1 << 0, // Fenced code in a language only Highlight.js knows
+    FeatureMath = 1 << 1  // $...$ and $$...$$, for MathJax
+};
+
+// ---------------------------------------------------------------------------
+// Search index
+//
+// With --search-index the converter feeds the text of every block it
+// renders into an inverted index: each term maps to the sections it occurs
+// in, a section being the part of a page under one heading (or above the
+// first). Indexes of single documents merge into one in time linear in
+// their postings, so batch workers each index their own files and the
+// results are joined at the end.
+// ---------------------------------------------------------------------------
+
+class SearchIndex
+{
+public:
+    struct Document
+    {
+        string url;
+        string title; // Text of the first heading
+    };
+
+    struct Section
+    {
+        uint32_t document;
+        string anchor; // Heading id; empty for the top of the page
+        string title;
+    };
+
+    // Sections are numbered in order, so each list is sorted by section
+    struct Posting
+    {
+        uint32_t section;
+        uint32_t count;
+    };
+
+private:
+    struct Term
+    {
+        string text;
+        uint32_t hash;
+        vector<Posting> postings;
+    };
+
+    vector<Document> documents;
+    vector<Section> sections;
+    vector<Term> terms;
+    vector<uint32_t> slots;      // Open addressing by hash: term index + 1, or 0 when free
+    bool sectionHasText = false; // The last section has postings
+    string word;                 // Scratch for addText
+
+    // Frequent English words every section has, left out to keep the index
+    // small. None is longer than four letters.
+    static bool isStopWord(const string &term)
+    {
+        static const char *const words[] = {"an", "and", "are", "as", "at", "be", "by", "for", "from",
+                                            "in", "is", "it", "of", "on", "or", "that", "the", "this",
+                                            "to", "was", "with"};
+        return binary_search(begin(words), end(words), term.c_str(), [](const char *a, const char *b)
+                             { return strcmp(a, b) < 0; });
+    }
+
+    // Postings of term, added when new. slots is kept at least twice the
+    // term count, a power of two, so probe runs stay short.
+    vector<Posting> &postingsFor(const string &term, uint32_t hash)
+    {
+        if (terms.size() * 2 >= slots.size())
+        {
+            slots.assign(max<size_t>(1024, slots.size() * 2), 0);
+            for (size_t t = 0; t < terms.size(); t++)
+            {
+                size_t slot = terms[t].hash & (slots.size() - 1);
+                while (slots[slot] != 0)
+                    slot = (slot + 1) & (slots.size() - 1);
+                slots[slot] = static_cast<uint32_t>(t + 1);
+            }
+        }
+        size_t slot = hash & (slots.size() - 1);
+        for (; slots[slot] != 0; slot = (slot + 1) & (slots.size() - 1))
+        {
+            Term &candidate = terms[slots[slot] - 1];
+            if (candidate.hash == hash && candidate.text == term)
+                return candidate.postings;
+        }
+        slots[slot] = static_cast<uint32_t>(terms.size() + 1);
+        terms.push_back({term, hash, {}});
+        return terms.back().postings;
+    }
+
+    void addTerm(const string &term, uint32_t hash, uint32_t section, uint32_t count)
+    {
+        sectionHasText = true;
+        vector<Posting> &postings = postingsFor(term, hash);
+        if (!postings.empty() && postings.back().section == section)
+            postings.back().count += count;
+        else
+            postings.push_back({section, count});
+    }
+
+    static void appendJsonString(string &out, string_view text)
+    {
+        out += '"';
+        for (char c : text)
+        {
+            unsigned char u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (u < 0x20)
+            {
+                static const char digits[] = "0123456789abcdef";
+                out += "\\u00";
+                out += digits[u >> 4];
+                out += digits[u & 0xf];
+            }
+            else
+                out += c;
+        }
+        out += '"';
+    }
+
+    static void appendVarint(string &out, uint64_t value)
+    {
+        for (; value >= 0x80; value >>= 7)
+            out += static_cast<char>((value & 0x7f) | 0x80);
+        out += static_cast<char>(value);
+    }
+
+    static void appendBytes(string &out, string_view text)
+    {
+        appendVarint(out, text.length());
+        out += text;
+    }
+
+    vector<const Term *> sortedTerms() const
+    {
+        vector<const Term *> sorted;
+        sorted.reserve(terms.size());
+        for (const Term &term : terms)
+            sorted.push_back(&term);
+        sort(sorted.begin(), sorted.end(), [](const Term *a, const Term *b)
+             { return a->text < b->text; });
+        return sorted;
+    }
+
+public:
+    // Starts a page; its top section takes the text before the first heading.
+    void beginDocument(string url)
+    {
+        documents.push_back({move(url), string()});
+        sections.push_back({static_cast<uint32_t>(documents.size() - 1), string(), string()});
+        sectionHasText = false;
+    }
+
+    // Starts the section under a heading of the current page. A page that
+    // opens with a heading has no top section of its own.
+    void beginSection(string_view anchor, string_view title)
+    {
+        if (documents.empty())
+            beginDocument(string());
+        if (documents.back().title.empty())
+            documents.back().title = string(title);
+        if (!sectionHasText && sections.back().anchor.empty())
+        {
+            sections.back().anchor = string(anchor);
+            sections.back().title = string(title);
+            return;
+        }
+        sections.push_back({static_cast<uint32_t>(documents.size() - 1), string(anchor), string(title)});
+        sectionHasText = false;
+    }
+
+    // Adds the words of text to the current section. A word is a run of
+    // ASCII letters and digits or non-ASCII bytes, lowercased; single
+    // characters, words over 40 bytes and stop words are skipped.
+    void addText(string_view text)
+    {
+        if (sections.empty())
+            beginDocument(string());
+        uint32_t section = static_cast<uint32_t>(sections.size() - 1);
+        auto isWordByte = [](unsigned char c)
+        { return c >= 0x80 || isalnum(c); };
+        const char *p = text.data();
+        size_t n = text.length();
+        for (size_t i = 0; i < n;)
+        {
+            if (!isWordByte(static_cast<unsigned char>(p[i])))
+            {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            while (i < n && isWordByte(static_cast<unsigned char>(p[i])))
+                i++;
+            size_t length = i - start;
+            if (length < 2 || length > 40)
+                continue;
+            word.assign(p + start, length);
+            for (char &c : word)
+            {
+                if (c >= 'A' && c <= 'Z')
+                    c = static_cast<char>(c - 'A' + 'a');
+            }
+            if (length > 4 || !isStopWord(word))
+                addTerm(word, fnv1aHash(word.data(), word.length()), section, 1);
+        }
+    }
+
+    // Appends the pages of other after those of this index. With
+    // continueDocument the first page of other is the rest of the current
+    // page instead, and text above its first heading continues the current
+    // section: that joins the pieces of a document converted on several
+    // threads.
+    void merge(SearchIndex &&other, bool continueDocument = false)
+    {
+        if (other.sections.empty())
+            return;
+        bool joined = continueDocument && !documents.empty();
+        bool joinedSection = joined && other.sections[0].anchor.empty();
+        if (joined && !joinedSection && !sectionHasText && sections.back().anchor.empty())
+            sections.pop_back(); // An empty top section, as beginSection would have dropped it
+        uint32_t documentBase = static_cast<uint32_t>(documents.size()) - (joined ? 1 : 0);
+        uint32_t sectionBase = static_cast<uint32_t>(sections.size()) - (joinedSection ? 1 : 0);
+
+        for (size_t d = 0; d < other.documents.size(); d++)
+        {
+            if (d == 0 && joined)
+            {
+                if (documents.back().title.empty())
+                    documents.back().title = move(other.documents[0].title);
+            }
+            else
+                documents.push_back(move(other.documents[d]));
+        }
+        for (size_t s = joinedSection ? 1 : 0; s < other.sections.size(); s++)
+        {
+            other.sections[s].document += documentBase;
+            sections.push_back(move(other.sections[s]));
+        }
+        bool lastHasText = sectionHasText;
+        for (const Term &term : other.terms)
+        {
+            for (const Posting &posting : term.postings)
+                addTerm(term.text, term.hash, posting.section + sectionBase, posting.count);
+        }
+        sectionHasText = other.sectionHasText || (joinedSection && other.sections.size() == 1 && lastHasText);
+        other = SearchIndex();
+    }
+
+    size_t documentCount() const { return documents.size(); }
+    size_t sectionCount() const { return sections.size(); }
+    size_t termCount() const { return terms.size(); }
+
+    // {"documents": [{"url", "title"}], "sections": [[document, anchor, title]],
+    //  "terms": {term: [section gap, count, ...]}}, terms in sorted order and
+    // each section number given as the gap from the one before it.
+    string json() const
+    {
+        string out = "{\"documents\":[";
+        for (size_t d = 0; d < documents.size(); d++)
+        {
+            out += d == 0 ? "{\"url\":" : ",\n{\"url\":";
+            appendJsonString(out, documents[d].url);
+            out += ",\"title\":";
+            appendJsonString(out, documents[d].title);
+            out += '}';
+        }
+        out += "],\n\"sections\":[";
+        for (size_t s = 0; s < sections.size(); s++)
+        {
+            out += s == 0 ? "[" : ",\n[";
+            out += to_string(sections[s].document);
+            out += ',';
+            appendJsonString(out, sections[s].anchor);
+            out += ',';
+            appendJsonString(out, sections[s].title);
+            out += ']';
+        }
+        out += "],\n\"terms\":{";
+        bool first = true;
+        for (const auto *term : sortedTerms())
+        {
+            out += first ? "\n" : ",\n";
+            first = false;
+            appendJsonString(out, term->text);
+            out += ":[";
+            uint32_t previous = 0;
+            for (size_t p = 0; p < term->postings.size(); p++)
+            {
+                const Posting &posting = term->postings[p];
+                if (p > 0)
+                    out += ',';
+                out += to_string(posting.section - previous);
+                out += ',';
+                out += to_string(posting.count);
+                previous = posting.section;
+            }
+            out += ']';
+        }
+        out += "}}\n";
+        return out;
+    }
+
+    // The same content as json(): "MDIX", a version byte, then varints and
+    // length-prefixed strings in the same order.
+    string binary() const
+    {
+        string out = "MDIX";
+        out += '\1';
+        appendVarint(out, documents.size());
+        for (const Document &document : documents)
+        {
+            appendBytes(out, document.url);
+            appendBytes(out, document.title);
+        }
+        appendVarint(out, sections.size());
+        for (const Section &section : sections)
+        {
+            appendVarint(out, section.document);
+            appendBytes(out, section.anchor);
+            appendBytes(out, section.title);
+        }
+        appendVarint(out, terms.size());
+        for (const auto *term : sortedTerms())
+        {
+            appendBytes(out, term->text);
+            appendVarint(out, term->postings.size());
+            uint32_t previous = 0;
+            for (const Posting &posting : term->postings)
+            {
+                appendVarint(out, posting.section - previous);
+                appendVarint(out, posting.count);
+                previous = posting.section;
+            }
+        }
+        return out;
+    }
+
+    // Writes the index as JSON, or in the binary form when path ends in .bin
+    bool write(const string &path) const
+    {
+        bool isBinary = fs::path(path).extension() == ".bin";
+        string data = isBinary ? binary() : json();
+        ofstream file(path, ios::binary);
+        file.write(data.data(), static_cast<streamsize>(data.length()));
+        return file.good();
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Profiling
+//
+// With --profile the converter charges the time between stage switches to
+// the stage that was running, so the stages add up to the whole run, and
+// counts the blocks and inline constructs it produced. With --alloc-stats
+// the heap allocations made in between are charged the same way.
+// ---------------------------------------------------------------------------
+
+enum class Stage : uint8_t
+{
+    Other,
+    Read,
+    Lines,
+    Blocks,
+    Inlines,
+    Render,
+    Toc,
+    Footnotes,
+    Template,
+    Write,
+    Index
+};
+
+static const char *const stageNames[] = {"other", "read", "lines", "blocks", "inlines", "render",
+                                         "toc", "footnotes", "template", "write", "index"};
+static const char *const stageDescriptions[] = {
+    "other, profiler bookkeeping", "read input", "split lines, footnote definitions", "block parsing", "inline parsing",
+    "render HTML", "generateTOC", "generateFootnotes", "page template", "write output",
+    "search index"};
+static const char *const blockTypeNames[] = {"paragraph", "heading", "thematic_break", "blockquote", "code_block", "code_line",
+                                             "table", "table_row", "table_cell", "list", "list_item"};
+static const char *const inlineTypeNames[] = {"text", "code", "math_inline", "math_block", "image", "link",
+                                              "autolink", "footnote_ref", "emoji", "emphasis", "strong", "strikethrough"};
+
+struct Profile
+{
+    static constexpr size_t stageCount = sizeof(stageNames) / sizeof(stageNames[0]);
+    static constexpr size_t blockTypeCount = sizeof(blockTypeNames) / sizeof(blockTypeNames[0]);
+    static constexpr size_t inlineTypeCount = sizeof(inlineTypeNames) / sizeof(inlineTypeNames[0]);
+    using clock = chrono::steady_clock;
+
+    double seconds[stageCount] = {};
+    size_t blocks[blockTypeCount] = {};
+    size_t inlines[inlineTypeCount] = {};
+    size_t inlineBytes[inlineTypeCount] = {};
+    size_t lines = 0;
+    size_t footnoteDefinitions = 0;
+    Stage current = Stage::Other;
+    clock::time_point since = clock::now();
+
+    bool countingAllocations = false;
+    size_t allocations[stageCount] = {};
+    size_t allocatedBytes[stageCount] = {};
+    int64_t peakLive[stageCount] = {};
+    size_t lastCount = 0;
+    size_t lastBytes = 0;
+
+    // Turns on the operator new counters; live bytes count from here.
+    void countAllocations()
+    {
+        countingAllocations = true;
+        lastCount = allocationCounters.count;
+        lastBytes = allocationCounters.bytes;
+        allocationCounters.peak = allocationCounters.live.load();
+        allocationCounters.enabled = true;
+    }
+
+    // Charges the time so far to the running stage and starts stage; returns
+    // the stage to go back to.
+    Stage enter(Stage stage)
+    {
+        clock::time_point now = clock::now();
+        size_t s = static_cast<size_t>(current);
+        seconds[s] += chrono::duration<double>(now - since).count();
+        since = now;
+        if (countingAllocations)
+        {
+            size_t count = allocationCounters.count;
+            size_t bytes = allocationCounters.bytes;
+            allocations[s] += count - lastCount;
+            allocatedBytes[s] += bytes - lastBytes;
+            lastCount = count;
+            lastBytes = bytes;
+            // The next stage's peak starts from what is live now
+            peakLive[s] = max(peakLive[s], allocationCounters.peak.exchange(allocationCounters.live));
+        }
+        Stage previous = current;
+        current = stage;
+        return previous;
+    }
+
+    void countInlines(const InlineNode *node)
+    {
+        for (; node != nullptr; node = node->next)
+        {
+            inlines[static_cast<size_t>(node->type)]++;
+            inlineBytes[static_cast<size_t>(node->type)] += node->text.length();
+            countInlines(node->firstChild);
+        }
+    }
+
+    void countBlocks(const BlockNode *block)
+    {
+        for (; block != nullptr; block = block->next)
+        {
+            blocks[static_cast<size_t>(block->type)]++;
+            countInlines(block->inlines);
+            countBlocks(block->children.first);
+        }
+    }
+
+    double totalSeconds() const
+    {
+        double total = 0;
+        for (double s : seconds)
+            total += s;
+        return total;
+    }
+
+    void report(ostream &out, const string &input, size_t bytes) const
+    {
+        double total = totalSeconds();
+        double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+        out << "Profile of " << input << " (" << bytes << " bytes, " << lines << " lines)\n"
+            << fixed << setprecision(3);
+        out << "  " << left << setw(36) << "stage" << right << setw(10) << "ms" << setw(8) << "%" << setw(12) << "MB/s" << "\n";
+        for (size_t s = 0; s < stageCount; s++)
+        {
+            out << "  " << left << setw(36) << stageDescriptions[s] << right << setw(10) << seconds[s] * 1e3
+                << setw(8) << setprecision(1) << (total > 0 ? 100.0 * seconds[s] / total : 0.0)
+                << setw(12) << (seconds[s] > 0 ? megabytes / seconds[s] : 0.0) << setprecision(3) << "\n";
+        }
+        out << "  " << left << setw(36) << "total" << right << setw(10) << total * 1e3 << setw(8) << "100.0"
+            << setw(12) << setprecision(1) << (total > 0 ? megabytes / total : 0.0) << "\n";
+
+        if (countingAllocations)
+        {
+            size_t totalCount = 0, totalBytes = 0;
+            int64_t peak = 0;
+            out << "  " << left << setw(36) << "allocations" << right << setw(10) << "count" << setw(14) << "bytes"
+                << setw(14) << "peak live" << "\n";
+            for (size_t s = 0; s < stageCount; s++)
+            {
+                totalCount += allocations[s];
+                totalBytes += allocatedBytes[s];
+                peak = max(peak, peakLive[s]);
+                if (allocations[s] > 0 || peakLive[s] > 0)
+                    out << "  " << left << setw(36) << stageDescriptions[s] << right << setw(10) << allocations[s]
+                        << setw(14) << allocatedBytes[s] << setw(14) << max<int64_t>(0, peakLive[s]) << "\n";
+            }
+            out << "  " << left << setw(36) << "total" << right << setw(10) << totalCount << setw(14) << totalBytes
+                << setw(14) << max<int64_t>(0, peak) << "\n"
+                << "  " << left << setw(36) << "per input MB" << right << setprecision(1)
+                << setw(10) << (megabytes > 0 ? totalCount / megabytes : 0.0)
+                << setw(14) << (megabytes > 0 ? totalBytes / megabytes : 0.0) << "\n";
+        }
+
+        // Each line of the input makes one node of its type; the rest are
+        // blank lines, fences and table separators
+        out << "  Lines by block type:\n";
+        size_t counted = footnoteDefinitions;
+        for (BlockType type : {BlockType::Paragraph, BlockType::Heading, BlockType::ListItem, BlockType::TableRow,
+                               BlockType::CodeLine, BlockType::Blockquote, BlockType::ThematicBreak})
+        {
+            size_t count = blocks[static_cast<size_t>(type)];
+            counted += count;
+            if (count > 0)
+                out << "    " << left << setw(20) << blockTypeNames[static_cast<size_t>(type)] << right << setw(10) << count << "\n";
+        }
+        if (footnoteDefinitions > 0)
+            out << "    " << left << setw(20) << "footnote_definition" << right << setw(10) << footnoteDefinitions << "\n";
+        if (lines > counted)
+            out << "    " << left << setw(20) << "blank_or_fence" << right << setw(10) << lines - counted << "\n";
+
+        out << "  Inline constructs:\n";
+        for (size_t t = 0; t < inlineTypeCount; t++)
+        {
+            if (inlines[t] > 0)
+                out << "    " << left << setw(20) << inlineTypeNames[t] << right << setw(10) << inlines[t]
+                    << setw(12) << inlineBytes[t] << " bytes\n";
+        }
+        out << left;
+    }
+
+    void reportJson(ostream &out, const string &input, size_t bytes) const
+    {
+        double total = totalSeconds();
+        string name;
+        for (char c : input)
+        {
+            if (c == '"' || c == '\\')
+                name += '\\';
+            name += c;
+        }
+        out << fixed << setprecision(6) << "{\n  \"input\": \"" << name << "\",\n  \"bytes\": " << bytes
+            << ",\n  \"lines\": " << lines << ",\n  \"seconds\": " << total << ",\n  \"stages\": {";
+        for (size_t s = 0; s < stageCount; s++)
+        {
+            out << (s == 0 ? "\n" : ",\n") << "    \"" << stageNames[s] << "\": {\"seconds\": " << seconds[s]
+                << ", \"mb_per_s\": " << (seconds[s] > 0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds[s] : 0.0);
+            if (countingAllocations)
+                out << ", \"allocations\": " << allocations[s] << ", \"allocated_bytes\": " << allocatedBytes[s]
+                    << ", \"peak_live_bytes\": " << max<int64_t>(0, peakLive[s]);
+            out << "}";
+        }
+        out << "\n  },";
+        if (countingAllocations)
+        {
+            size_t totalCount = 0, totalBytes = 0;
+            int64_t peak = 0;
+            for (size_t s = 0; s < stageCount; s++)
+            {
+                totalCount += allocations[s];
+                totalBytes += allocatedBytes[s];
+                peak = max(peak, peakLive[s]);
+            }
+            double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+            out << "\n  \"allocations\": {\"count\": " << totalCount << ", \"bytes\": " << totalBytes
+                << ", \"peak_live_bytes\": " << max<int64_t>(0, peak)
+                << ", \"count_per_mb\": " << (megabytes > 0 ? totalCount / megabytes : 0.0)
+                << ", \"bytes_per_mb\": " << (megabytes > 0 ? totalBytes / megabytes : 0.0) << "},";
+        }
+        out << "\n  \"blocks\": {";
+        for (size_t t = 0; t < blockTypeCount; t++)
+            out << (t == 0 ? "\n" : ",\n") << "    \"" << blockTypeNames[t] << "\": " << blocks[t];
+        out << ",\n    \"footnote_definition\": " << footnoteDefinitions << "\n  },\n  \"inlines\": {";
+        for (size_t t = 0; t < inlineTypeCount; t++)
+        {
+            out << (t == 0 ? "\n" : ",\n") << "    \"" << inlineTypeNames[t] << "\": {\"count\": " << inlines[t]
+                << ", \"bytes\": " << inlineBytes[t] << "}";
+        }
+        out << "\n  }\n}\n";
+    }
+};
+
+// Runs a scope as stage of profile, then returns to the stage before it.
+// Without a profile it does nothing.
+class StageTimer
+{
+private:
+    Profile *profile;
+    Stage previous = Stage::Other;
+
+public:
+    StageTimer(Profile *activeProfile, Stage stage) : profile(activeProfile)
+    {
+        if (profile != nullptr)
+            previous = profile->enter(stage);
+    }
+
+    ~StageTimer()
+    {
+        if (profile != nullptr)
+            profile->enter(previous);
+    }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+};
+
+// Everything one conversion works on: the document tree, open blocks, TOC
+// entries and footnotes, and a copy of the converter's settings. A context
+// is used by one thread at a time and can be reused for any number of
+// documents; MarkdownConverter keeps one per thread.
+class DocumentContext
+{
+    friend struct ConverterBench;
+    friend class IncrementalDocument;
+    friend class MarkdownConverter;
+
+private:
+    // A list that can still take items, with the indent of its markers
+    struct OpenList
+    {
+        BlockNode *list;
+        int indent;
+    };
+
+    // The document being parsed. Nodes live in arena; in streaming mode the
+    // finished blocks are rendered and the arena is reset as they complete.
+    Arena arena;
+    Arena scratch;
+    BlockList document;
+    vector<OpenList> openLists;
+    ConverterLimits limits;
+    Profile *profile = nullptr;
+    BlockNode *openTable = nullptr;
+    BlockNode *openCode = nullptr;
+    vector<string_view> tableCells;       // Scratch for parseTableRow
+    vector<TableAlign> tableAlignments;   // Of the open table's columns
+    HtmlRenderer renderer;
+    vector<TocEntry> tocEntries;
+    map<string, string> footnotes;
+    unsigned features = 0; // PageFeature bits seen in the document
+    SearchIndex *searchIndex = nullptr; // Takes the text of rendered blocks when set
+
+    static string_view trim(string_view str)
+    {
+        size_t start = str.find_first_not_of(" \t\r\n");
+        if (start == string_view::npos)
+            return {};
+        size_t end = str.find_last_not_of(" \t\r\n");
+        return str.substr(start, end - start + 1);
+    }
+
+    string escapeHtml(const string &text)
+    {
+        string escaped;
+        appendHtmlEscaped(escaped, text.data(), text.length());
+        return escaped;
+    }
+
+    // Lowercase letters and digits, with every other run of characters
+    // turned into a single hyphen between them.
+    string generateId(string_view text)
+    {
+        string id;
+        id.reserve(text.length());
+        for (char c : text)
+        {
+            unsigned char u = static_cast<unsigned char>(c);
+            if (isalnum(u))
+                id += static_cast<char>(tolower(u));
+            else if (!id.empty() && id.back() != '-')
+                id += '-';
+        }
+        if (!id.empty() && id.back() == '-')
+            id.pop_back();
+        return id;
+    }
+
+    // Splits a row into trimmed cells in one scan. A pipe escaped as \| does
+    // not end a cell and stands for a literal pipe: such cells are copied
+    // into the arena without the backslashes, the rest are views into line.
+    // The last of maxCells cells takes the rest of the row, pipes included.
+    // The cells stay valid until the next call.
+    const vector<string_view> &parseTableRow(string_view line, size_t maxCells = SIZE_MAX)
+    {
+        vector<string_view> &cells = tableCells;
+        cells.clear();
+        string_view trimmed = trim(line);
+
+        // Remove leading and trailing pipes if they exist
+        if (!trimmed.empty() && trimmed.front() == '|')
+            trimmed.remove_prefix(1);
+        if (!trimmed.empty() && trimmed.back() == '|' && (trimmed.length() < 2 || trimmed[trimmed.length() - 2] != '\\'))
+            trimmed.remove_suffix(1);
+
+        size_t start = 0;
+        while (start < trimmed.length())
+        {
+            size_t end = trimmed.length();
+            bool escaped = false;
+            if (cells.size() + 1 < maxCells)
+            {
+                for (end = findTableCellEnd(trimmed, start); end != string_view::npos; end = findTableCellEnd(trimmed, end + 2))
+                {
+                    if (trimmed[end] == '|')
+                        break;
+                    escaped = escaped || (end + 1 < trimmed.length() && trimmed[end + 1] == '|');
+                }
+                if (end == string_view::npos)
+                    end = trimmed.length();
+            }
+            else
+                escaped = trimmed.find("\\|", start) != string_view::npos;
+
+            string_view cell = trim(trimmed.substr(start, end - start));
+            if (escaped)
+            {
+                string unescaped;
+                unescaped.reserve(cell.length());
+                for (size_t k = 0; k < cell.length(); k++)
+                {
+                    if (cell[k] == '\\' && k + 1 < cell.length() && cell[k + 1] == '|')
+                        k++;
+                    unescaped += cell[k];
+                }
+                cell = arena.copy(unescaped);
+            }
+            cells.push_back(cell);
+            start = end + 1;
+        }
+
+        return cells;
+    }
+
+    // Recognizes the delimiter row under a table header, such as
+    // "|---|:--:|--:|", and records each column's alignment.
+    bool parseTableSeparator(string_view line)
+    {
+        const vector<string_view> &parts = parseTableRow(line);
+        if (parts.empty())
+            return false;
+
+        tableAlignments.clear();
+        for (string_view part : parts)
+        {
+            if (part.empty())
+                return false;
+
+            // Check if it contains only allowed characters: -, :, and spaces
+            for (char c : part)
+            {
+                if (c != '-' && c != ':' && c != ' ')
+                {
+                    return false;
+                }
+            }
+
+            // Must contain at least one dash
+            if (part.find('-') == string_view::npos)
+                return false;
+
+            bool left = part.front() == ':';
+            bool right = part.back() == ':';
+            tableAlignments.push_back(left && right ? TableAlign::Center
+                                                    : (right ? TableAlign::Right : (left ? TableAlign::Left : TableAlign::None)));
+        }
+
+        return true;
+    }
+
+    int getIndentLevel(string_view line)
+    {
+        int level = 0;
+        for (char c : line)
+        {
+            if (c == ' ')
+                level++;
+            else if (c == '\t')
+                level += 4;
+            else
+                break;
+        }
+        return level / 2; // Assuming 2 spaces per indent level
+    }
+
+    // A run of '*', '_' or '~' seen by the inline scanner. The run is added
+    // as a text node; once the line is done, matched runs give up their
+    // characters and the nodes between them move under an emphasis node.
+    struct Delimiter
+    {
+        InlineNode *node;
+        char ch;
+        int count;
+        int origCount;
+        bool canOpen;
+        bool canClose;
+        size_t prev;   // Previous run that may still match, or npos
+        int depth;     // Deepest emphasis between this run and the next one
+    };
+
+    // Shared by nested parseInlines calls; each works on the entries it pushed.
+    vector<Delimiter> delimiters;
+
+    static bool isSpaceOrEdge(char c)
+    {
+        return c == '\0' || isspace(static_cast<unsigned char>(c));
+    }
+
+    static bool isPunctuation(char c)
+    {
+        return c != '\0' && ispunct(static_cast<unsigned char>(c));
+    }
+
+    // A run of backticks and the index of the next run of the same length.
+    struct BacktickRun
+    {
+        size_t pos;
+        size_t length;
+        size_t next;
+    };
+
+    // Indexes the backtick runs of text from `from` on, so each code span
+    // finds its closer without rescanning the line; count is set to the
+    // number of runs. The index lives in nodes with the line's nodes.
+    static BacktickRun *indexBacktickRuns(Arena &nodes, string_view text, size_t from, size_t &count)
+    {
+        count = 0;
+        size_t longest = 0;
+        for (size_t i = text.find('`', from); i != string::npos; i = text.find('`', i))
+        {
+            size_t j = i;
+            while (j < text.length() && text[j] == '`')
+                j++;
+            count++;
+            longest = max(longest, j - i);
+            i = j;
+        }
+
+        BacktickRun *runs = static_cast<BacktickRun *>(nodes.allocate(count * sizeof(BacktickRun), alignof(BacktickRun)));
+        size_t k = 0;
+        for (size_t i = text.find('`', from); i != string::npos; i = text.find('`', i))
+        {
+            size_t j = i;
+            while (j < text.length() && text[j] == '`')
+                j++;
+            runs[k++] = {i, j - i, string::npos};
+            i = j;
+        }
+
+        // Walking backwards, the last run seen of each length is the next one
+        size_t *lastOfLength = static_cast<size_t *>(nodes.allocate((longest + 1) * sizeof(size_t), alignof(size_t)));
+        fill(lastOfLength, lastOfLength + longest + 1, string::npos);
+        for (size_t r = count; r-- > 0;)
+        {
+            runs[r].next = lastOfLength[runs[r].length];
+            lastOfLength[runs[r].length] = r;
+        }
+        return runs;
+    }
+
+    // Length of an http(s) URL starting at `pos`, or 0 if there is none.
+    static size_t autolinkLength(string_view text, size_t pos)
+    {
+        size_t schemeLen = 0;
+        if (text.compare(pos, 7, "http://") == 0)
+            schemeLen = 7;
+        else if (text.compare(pos, 8, "https://") == 0)
+            schemeLen = 8;
+        else
+            return 0;
+
+        size_t end = pos + schemeLen;
+        while (end < text.length())
+        {
+            char c = text[end];
+            if (isspace(static_cast<unsigned char>(c)) || c == ')' || c == '<' || c == '>' || c == '"')
+                break;
+            end++;
+        }
+        // Trailing punctuation belongs to the sentence, not the URL
+        while (end > pos + schemeLen && strchr("?!.,:*_~'", text[end - 1]) != nullptr)
+            end--;
+
+        return end > pos + schemeLen ? end - pos : 0;
+    }
+
+    // Pairs up the runs pushed since base, closers left to right, each with
+    // the nearest opener below it (the CommonMark procedure). Runs that can
+    // no longer match are unlinked from the prev chain, and openersBottom
+    // remembers, per kind of closer, where an earlier search came up empty,
+    // so each run is passed over a bounded number of times and a line of
+    // unmatched runs stays linear.
+    void processEmphasis(Arena &nodes, size_t base)
+    {
+        const size_t none = string::npos;
+        size_t openersBottom[3][2][3]; // [character][closer can open][closer length % 3]
+        for (auto &byChar : openersBottom)
+            for (auto &byOpen : byChar)
+                fill(begin(byOpen), end(byOpen), base);
+
+        for (size_t c = base; c < delimiters.size(); c++)
+        {
+            Delimiter &closer = delimiters[c];
+            if (!closer.canClose)
+                continue;
+
+            size_t &bottom = openersBottom[closer.ch == '*' ? 0 : (closer.ch == '_' ? 1 : 2)][closer.canOpen][closer.origCount % 3];
+            while (closer.count > 0)
+            {
+                size_t o = closer.prev;
+                for (; o != none && o >= bottom; o = delimiters[o].prev)
+                {
+                    const Delimiter &opener = delimiters[o];
+                    if (!opener.canOpen || opener.ch != closer.ch)
+                        continue;
+                    // "Rule of 3": a run that can both open and close only
+                    // pairs up when the combined length is not a multiple of 3
+                    if (closer.ch != '~' && (opener.canClose || closer.canOpen) &&
+                        (opener.origCount + closer.origCount) % 3 == 0 &&
+                        (opener.origCount % 3 != 0 || closer.origCount % 3 != 0))
+                        continue;
+                    break;
+                }
+                if (o == none || o < bottom)
+                {
+                    bottom = c;
+                    break;
+                }
+
+                Delimiter &opener = delimiters[o];
+                int use = (closer.ch == '~' || (opener.count >= 2 && closer.count >= 2)) ? 2 : 1;
+
+                // Anything between a matched pair can no longer match outside it
+                int depth = opener.depth;
+                for (size_t k = closer.prev; k != o; k = delimiters[k].prev)
+                    depth = max(depth, delimiters[k].depth);
+                closer.prev = o;
+
+                // Past the nesting limit the runs stay as literal text
+                if (depth < limits.maxNesting)
+                {
+                    InlineNode *wrapper = nodes.make<InlineNode>();
+                    wrapper->type = closer.ch == '~' ? InlineType::Strikethrough : (use == 2 ? InlineType::Strong : InlineType::Emphasis);
+
+                    // Everything between the two runs moves under the new node
+                    InlineNode *inner = opener.node->next;
+                    if (inner != closer.node)
+                    {
+                        wrapper->firstChild = inner;
+                        while (inner->next != closer.node)
+                            inner = inner->next;
+                        inner->next = nullptr;
+                    }
+                    opener.node->next = wrapper;
+                    wrapper->next = closer.node;
+
+                    opener.node->text.remove_suffix(use);
+                    closer.node->text.remove_prefix(use);
+                    depth++;
+                }
+                opener.count -= use;
+                closer.count -= use;
+                opener.depth = depth;
+
+                if (opener.count == 0)
+                {
+                    closer.prev = opener.prev;
+                    if (opener.prev != none)
+                        delimiters[opener.prev].depth = max(delimiters[opener.prev].depth, opener.depth);
+                }
+            }
+
+            // A spent closer, or one that cannot open either, is done with
+            if (closer.count == 0 || !closer.canOpen)
+            {
+                if (c + 1 < delimiters.size())
+                    delimiters[c + 1].prev = closer.prev;
+                if (closer.prev != none)
+                    delimiters[closer.prev].depth = max(delimiters[closer.prev].depth, closer.depth);
+            }
+        }
+    }
+
+    // Single left-to-right scan over one line of inline markdown. Code spans,
+    // math, images, links, footnote references, autolinks and emojis become
+    // nodes as they are met; emphasis and strikethrough runs go on a
+    // delimiter stack that is resolved at the end of the line. Nodes point
+    // into text, which must outlive them.
+    InlineNode *parseInlines(Arena &nodes, string_view text, bool allowLinks)
+    {
+        // Link text is parsed by a nested call, timed with its line
+        StageTimer timer(allowLinks ? profile : nullptr, Stage::Inlines);
+
+        // Past the length limit a line is only escaped
+        if (text.length() > limits.maxLineLength)
+        {
+            InlineNode *node = nodes.make<InlineNode>();
+            node->text = text;
+            return node;
+        }
+
+        InlineList list;
+        InlineNode *openText = nullptr; // Text node that plain text may extend
+        size_t base = delimiters.size();
+        size_t n = text.length();
+        size_t i = 0;
+
+        // Closing characters are looked up from ever later positions, so the
+        // last answer stands until the scan passes it; a line of unclosed
+        // brackets costs one scan rather than one per bracket.
+        struct Found
+        {
+            size_t from = string::npos;
+            size_t at = string::npos;
+        };
+        Found closeBracket, closeParen, dollar;
+        auto find = [&](char ch, size_t from, Found &found)
+        {
+            if (found.from > from || (found.at != string::npos && found.at < from))
+            {
+                found.from = from;
+                found.at = text.find(ch, from);
+            }
+            return found.at;
+        };
+        BacktickRun *backticks = nullptr;
+        size_t backtickCount = 0, backtickIndex = 0;
+
+        auto add = [&](InlineType type)
+        {
+            InlineNode *node = nodes.make<InlineNode>();
+            node->type = type;
+            list.append(node);
+            openText = nullptr;
+            return node;
+        };
+        auto addText = [&](size_t from, size_t to)
+        {
+            if (openText != nullptr && openText->text.data() + openText->text.length() == text.data() + from)
+                openText->text = string_view(openText->text.data(), openText->text.length() + to - from);
+            else
+            {
+                add(InlineType::Text)->text = text.substr(from, to - from);
+                openText = list.last;
+            }
+        };
+
+        while (i < n)
+        {
+            // Take plain text up to the next character that could start markup
+            size_t plain = i + findInlineSpecial(text.data() + i, n - i);
+            if (plain > i)
+            {
+                addText(i, plain);
+                i = plain;
+                if (i >= n)
+                    break;
+            }
+
+            char c = text[i];
+            switch (c)
+            {
+            case '`':
+            {
+                size_t run = 1;
+                while (i + run < n && text[i + run] == '`')
+                    run++;
+                if (backticks == nullptr)
+                    backticks = indexBacktickRuns(nodes, text, i, backtickCount);
+                while (backtickIndex < backtickCount && backticks[backtickIndex].pos < i)
+                    backtickIndex++;
+                size_t close = string::npos;
+                if (backtickIndex < backtickCount && backticks[backtickIndex].pos == i && backticks[backtickIndex].next != string::npos)
+                    close = backticks[backticks[backtickIndex].next].pos;
+                if (close != string::npos && close > i + run)
+                {
+                    add(InlineType::Code)->text = text.substr(i + run, close - i - run);
+                    i = close + run;
+                }
+                else
+                {
+                    addText(i, i + run);
+                    i += run;
+                }
+                continue;
+            }
+            case '$':
+            {
+                size_t close = find('$', i + 1, dollar);
+                if (i + 1 < n && text[i + 1] == '$')
+                {
+                    // Block math: $$...$$
+                    close = find('$', i + 2, dollar);
+                    if (close != string::npos && close > i + 2 && close + 1 < n && text[close + 1] == '$')
+                    {
+                        add(InlineType::MathBlock)->text = text.substr(i + 2, close - i - 2);
+                        features |= FeatureMath;
+                        i = close + 2;
+                        continue;
+                    }
+                }
+                else if (close != string::npos && close > i + 1)
+                {
+                    // Inline math: $...$
+                    add(InlineType::MathInline)->text = text.substr(i + 1, close - i - 1);
+                    features |= FeatureMath;
+                    i = close + 1;
+                    continue;
+                }
+                addText(i, i + 1);
+                i++;
+                continue;
+            }
+            case '!':
+            {
+                // Images: ![alt](src)
+                if (i + 1 < n && text[i + 1] == '[')
+                {
+                    size_t altEnd = find(']', i + 2, closeBracket);
+                    if (altEnd != string::npos && altEnd + 1 < n && text[altEnd + 1] == '(')
+                    {
+                        size_t srcEnd = find(')', altEnd + 2, closeParen);
+                        if (srcEnd != string::npos && srcEnd > altEnd + 2)
+                        {
+                            InlineNode *image = add(InlineType::Image);
+                            image->url = text.substr(altEnd + 2, srcEnd - altEnd - 2);
+                            image->text = text.substr(i + 2, altEnd - i - 2);
+                            i = srcEnd + 1;
+                            continue;
+                        }
+                    }
+                }
+                addText(i, i + 1);
+                i++;
+                continue;
+            }
+            case '[':
+            {
+                size_t close = find(']', i + 1, closeBracket);
+                if (close != string::npos && i + 1 < n && text[i + 1] == '^')
+                {
+                    // Footnote references: [^id]
+                    if (close > i + 2)
+                    {
+                        add(InlineType::FootnoteRef)->text = text.substr(i + 2, close - i - 2);
+                        i = close + 1;
+                        continue;
+                    }
+                }
+                else if (allowLinks && close != string::npos && close > i + 1 && close + 1 < n && text[close + 1] == '(')
+                {
+                    // Links: [text](url)
+                    size_t urlEnd = find(')', close + 2, closeParen);
+                    if (urlEnd != string::npos && urlEnd > close + 2)
+                    {
+                        InlineNode *link = add(InlineType::Link);
+                        link->url = text.substr(close + 2, urlEnd - close - 2);
+                        link->firstChild = parseInlines(nodes, text.substr(i + 1, close - i - 1), false);
+                        i = urlEnd + 1;
+                        continue;
+                    }
+                }
+                addText(i, i + 1);
+                i++;
+                continue;
+            }
+            case ':':
+            {
+                // Auto-link raw URLs (http/https). The scheme letters have
+                // already been taken as plain text, so take them back out.
+                if (allowLinks && text.compare(i, 3, "://") == 0)
+                {
+                    size_t schemeLen = 0;
+                    if (i >= 5 && text.compare(i - 5, 5, "https") == 0)
+                        schemeLen = 5;
+                    else if (i >= 4 && text.compare(i - 4, 4, "http") == 0)
+                        schemeLen = 4;
+                    size_t start = i - schemeLen;
+                    size_t len = 0;
+                    if (schemeLen > 0 && openText != nullptr && openText->text.length() >= schemeLen &&
+                        (start == 0 || !isalnum(static_cast<unsigned char>(text[start - 1]))))
+                        len = autolinkLength(text, start);
+                    if (len > 0)
+                    {
+                        openText->text.remove_suffix(schemeLen);
+                        add(InlineType::Autolink)->url = text.substr(start, len);
+                        i = start + len;
+                        continue;
+                    }
+                }
+
+                // Emojis: :name:
+                size_t end = i + 1;
+                while (end < n && (isalnum(static_cast<unsigned char>(text[end])) || text[end] == '_' || text[end] == '+' || text[end] == '-'))
+                    end++;
+                if (end < n && end > i + 1 && text[end] == ':')
+                {
+                    const char *emoji = lookupEmoji(text.data() + i + 1, end - i - 1);
+                    if (emoji != nullptr)
+                    {
+                        add(InlineType::Emoji)->text = emoji;
+                        i = end + 1;
+                        continue;
+                    }
+                }
+                addText(i, i + 1);
+                i++;
+                continue;
+            }
+            case '*':
+            case '_':
+            case '~':
+            {
+                size_t run = 1;
+                while (i + run < n && text[i + run] == c)
+                    run++;
+                if (c == '~' && run != 2)
+                {
+                    addText(i, i + run);
+                    i += run;
+                    continue;
+                }
+
+                char before = i > 0 ? text[i - 1] : '\0';
+                char after = i + run < n ? text[i + run] : '\0';
+                bool leftFlanking = !isSpaceOrEdge(after) &&
+                                    (!isPunctuation(after) || isSpaceOrEdge(before) || isPunctuation(before));
+                bool rightFlanking = !isSpaceOrEdge(before) &&
+                                     (!isPunctuation(before) || isSpaceOrEdge(after) || isPunctuation(after));
+
+                Delimiter d;
+                d.node = add(InlineType::Text);
+                d.node->text = text.substr(i, run);
+                d.ch = c;
+                d.count = d.origCount = static_cast<int>(run);
+                d.prev = delimiters.size() > base ? delimiters.size() - 1 : string::npos;
+                d.depth = 0;
+                if (c == '_')
+                {
+                    // No intraword emphasis with underscores (snake_case stays as is)
+                    d.canOpen = leftFlanking && (!rightFlanking || isPunctuation(before));
+                    d.canClose = rightFlanking && (!leftFlanking || isPunctuation(after));
+                }
+                else
+                {
+                    d.canOpen = leftFlanking;
+                    d.canClose = rightFlanking;
+                }
+                delimiters.push_back(d);
+                i += run;
+                continue;
+            }
+            default:
+                // '&', '<' or '>', escaped when rendered
+                addText(i, i + 1);
+                i++;
+                continue;
+            }
+        }
+
+        if (delimiters.size() > base)
+        {
+            processEmphasis(nodes, base);
+            delimiters.resize(base);
+        }
+        return list.first;
+    }
+
+    string processInlineFormatting(string_view line)
+    {
+        scratch.reset();
+        string html;
+        renderer.renderInlines(parseInlines(scratch, line, true), html);
+        return html;
+    }
+
+    BlockNode *newBlock(BlockType type)
+    {
+        BlockNode *block = arena.make<BlockNode>();
+        block->type = type;
+        return block;
+    }
+
+    BlockNode *addBlock(BlockType type)
+    {
+        BlockNode *block = newBlock(type);
+        document.append(block);
+        return block;
+    }
+
+    BlockNode *addHeading(string_view line)
+    {
+        int level = 0;
+        for (char c : line)
+        {
+            if (c == '#')
+                level++;
+            else
+                break;
+        }
+
+        if (level > 6)
+            level = 6;
+
+        BlockNode *heading = addBlock(BlockType::Heading);
+        heading->level = static_cast<uint8_t>(level);
+        heading->text = trim(line.substr(level));
+        heading->id = arena.copy(generateId(heading->text));
+        heading->inlines = parseInlines(arena, heading->text, true);
+        return heading;
+    }
+
+    void addTableRow(string_view line, bool header)
+    {
+        BlockNode *row = newBlock(BlockType::TableRow);
+        row->header = header;
+        size_t column = 0;
+        for (string_view cellText : parseTableRow(line, limits.maxTableColumns))
+        {
+            BlockNode *cell = newBlock(BlockType::TableCell);
+            if (column < tableAlignments.size())
+                cell->align = tableAlignments[column];
+            column++;
+
+            // Numbers and plain words, the bulk of a generated report, need
+            // no inline parsing
+            if (findInlineSpecial(cellText.data(), cellText.length()) == cellText.length())
+            {
+                cell->plain = true;
+                cell->text = cellText;
+            }
+            else
+                cell->inlines = parseInlines(arena, cellText, true);
+            row->children.append(cell);
+        }
+        openTable->children.append(row);
+    }
+
+    // Recognizes "- ", "* ", "+ " and "1. " list markers; contentStart is
+    // set to where the item text begins.
+    bool isListItem(string_view line, bool &ordered, size_t &contentStart)
+    {
+        if (line.length() >= 2 && (line[0] == '-' || line[0] == '*' || line[0] == '+') && line[1] == ' ')
+        {
+            ordered = false;
+            contentStart = 2;
+            return true;
+        }
+        if (isOrderedListItem(line))
+        {
+            ordered = true;
+            contentStart = line.find(". ") + 2;
+            return true;
+        }
+        return false;
+    }
+
+    bool isOrderedListItem(string_view line)
+    {
+        if (line.empty())
+            return false;
+        size_t i = 0;
+        while (i < line.length() && isdigit(line[i]))
+            i++;
+        return i > 0 && i < line.length() && line[i] == '.' && i + 1 < line.length() && line[i + 1] == ' ';
+    }
+
+    // Adds an item to the list open at indent, opening (or nesting) a list
+    // as needed.
+    void addListItem(int indent, bool ordered, TaskState task, string_view content)
+    {
+        while (!openLists.empty() && openLists.back().indent > indent)
+            openLists.pop_back();
+        if (!openLists.empty() && openLists.back().indent == indent && openLists.back().list->ordered != ordered)
+            openLists.pop_back();
+
+        // Past the nesting limit, deeper items join the innermost list
+        if (openLists.size() >= static_cast<size_t>(max(1, limits.maxNesting)) && openLists.back().indent < indent)
+            indent = openLists.back().indent;
+
+        if (openLists.empty() || openLists.back().indent < indent)
+        {
+            BlockNode *list = newBlock(BlockType::List);
+            list->ordered = ordered;
+            list->task = task;
+            if (openLists.empty())
+                document.append(list);
+            else
+                openLists.back().list->children.last->children.append(list);
+            openLists.push_back({list, indent});
+        }
+
+        BlockNode *item = newBlock(BlockType::ListItem);
+        item->task = task;
+        item->inlines = parseInlines(arena, content, true);
+        openLists.back().list->children.append(item);
+    }
+
+    void closeLists()
+    {
+        openLists.clear();
+    }
+
+    string generateTOC()
+    {
+        StageTimer timer(profile, Stage::Toc);
+        if (tocEntries.empty())
+            return "";
+
+        string toc = "<div class=\"toc\">\n<h2>Table of Contents</h2>\n<ul>\n";
+
+        for (const auto &entry : tocEntries)
+        {
+            toc.append(entry.level - 1, ' ');
+            toc += "  <li><a href=\"#";
+            toc += entry.id;
+            toc += "\">";
+            appendHtmlEscaped(toc, entry.text.data(), entry.text.length());
+            toc += "</a></li>\n";
+        }
+
+        toc += "</ul>\n</div>\n\n";
+        return toc;
+    }
+
+    string generateFootnotes()
+    {
+        StageTimer timer(profile, Stage::Footnotes);
+        if (footnotes.empty())
+            return "";
+
+        string result = "\n<div class=\"footnotes\">\n<hr>\n<ol>\n";
+
+        for (const auto &note : footnotes)
+        {
+            result += "<li id=\"fn";
+            appendHtmlEscaped(result, note.first.data(), note.first.length(), true);
+            result += "\">";
+            result += processInlineFormatting(note.second);
+            result += " <a href=\"#fnref";
+            appendHtmlEscaped(result, note.first.data(), note.first.length(), true);
+            result += "\" class=\"footnote-backref\">↩</a></li>\n";
+        }
+
+        result += "</ol>\n</div>\n";
+        return result;
+    }
+
+    // Stores the line as a footnote if it is a definition ("[^id]: text").
+    bool extractFootnote(string_view line)
+    {
+        if (line.length() > 3 && line[0] == '[' && line[1] == '^')
+        {
+            size_t closeBracket = line.find("]:");
+            if (closeBracket != string_view::npos && closeBracket > 2)
+            {
+                string footnoteId(line.substr(2, closeBracket - 2));
+                if (footnotes.size() >= limits.maxFootnotes && footnotes.count(footnoteId) == 0)
+                    return false;
+                string_view footnoteText = line.substr(closeBracket + 2);
+                footnotes[footnoteId] = string(trim(footnoteText));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Next line that is not a footnote definition
+    bool readLine(LineSource &source, string_view &line, bool &plain)
+    {
+        StageTimer timer(profile, Stage::Lines);
+        while (source.next(line, plain))
+        {
+            if (profile != nullptr)
+                profile->lines++;
+            if (!extractFootnote(line))
+                return true;
+            if (profile != nullptr)
+                profile->footnoteDefinitions++;
+            source.release();
+        }
+        return false;
+    }
+
+    // Adds one line to the document tree. next is the following line, if
+    // any; returns true when that line was consumed too. Nodes keep views
+    // into rawLine.
+    bool parseLine(string_view rawLine, bool plain, const string_view *next)
+    {
+        string_view line = trim(rawLine);
+
+        // Inside code block: lines are kept as they are, blank ones included
+        if (openCode != nullptr)
+        {
+            if (line.substr(0, 3) == "```")
+            {
+                openCode = nullptr;
+                return false;
+            }
+            if (!rawLine.empty() && rawLine.back() == '\r')
+                rawLine.remove_suffix(1);
+            BlockNode *codeLine = newBlock(BlockType::CodeLine);
+            codeLine->text = rawLine;
+            openCode->children.append(codeLine);
+            return false;
+        }
+
+        // Empty lines
+        if (line.empty())
+        {
+            closeLists();
+            openTable = nullptr;
+            return false;
+        }
+
+        // Code blocks
+        if (line.substr(0, 3) == "```")
+        {
+            closeLists();
+            openTable = nullptr;
+            openCode = addBlock(BlockType::CodeBlock);
+            openCode->text = line.substr(3);
+            // Languages the renderer highlights itself need no script
+            if (findLanguage(openCode->text) == nullptr && !trim(openCode->text).empty())
+                features |= FeatureCode;
+            return false;
+        }
+
+        // Table detection
+        if (!plain && openTable == nullptr && line.find('|') != string_view::npos)
+        {
+            // Check if this might be a table
+            if (next != nullptr && parseTableSeparator(*next))
+            {
+                closeLists();
+                openTable = addBlock(BlockType::Table);
+                addTableRow(line, true);
+                return true; // Separator line consumed
+            }
+        }
+
+        // Table rows
+        if (openTable != nullptr && !plain && line.find('|') != string_view::npos)
+        {
+            addTableRow(line, false);
+            return false;
+        }
+        openTable = nullptr;
+
+        // Plain prose: nothing in the line can open a heading, quote, table
+        // or inline markup, so it goes straight into a paragraph
+        if (plain && line[0] != '-' && line[0] != '+' && !isdigit(static_cast<unsigned char>(line[0])))
+        {
+            closeLists();
+            BlockNode *paragraph = addBlock(BlockType::Paragraph);
+            paragraph->plain = true;
+            paragraph->text = line;
+            return false;
+        }
+
+        bool ordered = false;
+        size_t contentStart = 0;
+
+        // Headings
+        if (line[0] == '#')
+        {
+            closeLists();
+            addHeading(line);
+        }
+        // Horizontal rule
+        else if (line == "---" || line == "***" || line == "___")
+        {
+            closeLists();
+            addBlock(BlockType::ThematicBreak);
+        }
+        // Blockquotes
+        else if (line[0] == '>')
+        {
+            closeLists();
+            addBlock(BlockType::Blockquote)->inlines = parseInlines(arena, trim(line.substr(1)), true);
+        }
+        // Lists, nested by the indent of the marker; task items are "- [x] "
+        // or "- [ ] "
+        else if (isListItem(line, ordered, contentStart))
+        {
+            string_view content = line.substr(contentStart);
+            TaskState task = TaskState::None;
+            if (!ordered && content.length() >= 4 && content[0] == '[' && content[2] == ']' && content[3] == ' ')
+            {
+                if (content[1] == 'x' || content[1] == 'X')
+                    task = TaskState::Done;
+                else if (content[1] == ' ')
+                    task = TaskState::Open;
+                if (task != TaskState::None)
+                    content.remove_prefix(4);
+            }
+            addListItem(getIndentLevel(rawLine), ordered, task, trim(content));
+        }
+        // Paragraph
+        else
+        {
+            closeLists();
+            addBlock(BlockType::Paragraph)->inlines = parseInlines(arena, line, true);
+        }
+        return false;
+    }
+
+    void closeBlocks()
+    {
+        closeLists();
+        openTable = nullptr;
+        openCode = nullptr;
+    }
+
+    // Adds the words of blocks to the search index, a heading starting a
+    // new section. Code blocks, math, URLs and emoji are left out.
+    void indexBlocks(const BlockNode *block)
+    {
+        for (; block != nullptr; block = block->next)
+        {
+            if (block->type == BlockType::Heading)
+            {
+                searchIndex->beginSection(block->id, block->text);
+                searchIndex->addText(block->text);
+            }
+            else if (block->type != BlockType::CodeBlock)
+            {
+                if (block->plain)
+                    searchIndex->addText(block->text);
+                indexInlines(block->inlines);
+                indexBlocks(block->children.first);
+            }
+        }
+    }
+
+    void indexInlines(const InlineNode *node)
+    {
+        for (; node != nullptr; node = node->next)
+        {
+            switch (node->type)
+            {
+            case InlineType::Text:
+            case InlineType::Code:
+            case InlineType::Image:
+                searchIndex->addText(node->text);
+                break;
+            case InlineType::Link:
+            case InlineType::Emphasis:
+            case InlineType::Strong:
+            case InlineType::Strikethrough:
+                indexInlines(node->firstChild);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    // Renders the blocks parsed so far, records their headings for the TOC
+    // and releases them.
+    void renderDocument(string &html)
+    {
+        StageTimer timer(profile, Stage::Render);
+        for (const BlockNode *block = document.first; block != nullptr; block = block->next)
+        {
+            if (block->type == BlockType::Heading)
+                tocEntries.push_back({block->level, string(block->id), string(block->text)});
+        }
+        if (searchIndex != nullptr)
+        {
+            StageTimer indexTimer(profile, Stage::Index);
+            indexBlocks(document.first);
+        }
+        if (profile != nullptr)
+        {
+            StageTimer countTimer(profile, Stage::Other);
+            profile->countBlocks(document.first);
+        }
+        // An open table is the last block; its rows so far are written and
+        // the rest of it goes into a new node
+        const BlockNode *block = document.first;
+        for (; block != nullptr && block != openTable; block = block->next)
+            renderer.renderBlock(*block, html);
+        if (openTable != nullptr)
+            renderer.renderTable(*openTable, false, html);
+        document = BlockList();
+        arena.reset();
+        if (openTable != nullptr)
+        {
+            openTable = addBlock(BlockType::Table);
+            openTable->header = true;
+        }
+    }
+
+    // Clears everything a previous document left behind, including what a
+    // conversion that threw halfway through may have left, so an instance
+    // can be reused for any number of documents.
+    void beginDocument()
+    {
+        closeBlocks();
+        document = BlockList();
+        arena.reset();
+        scratch.reset();
+        delimiters.clear();
+        tocEntries.clear();
+        footnotes.clear();
+        features = 0;
+    }
+
+    // Arena memory kept from one document to the next; more than this is
+    // given back once a document is done
+    static constexpr size_t retainedArenaBytes = 1024 * 1024;
+
+    // Drops the finished document and trims both arenas, for contexts that
+    // outlive the call that used them
+    void endDocument()
+    {
+        document = BlockList();
+        arena.trim(retainedArenaBytes);
+        scratch.trim(retainedArenaBytes);
+    }
+
+    // Parses every line of source into the document tree. When out is given
+    // the finished blocks are rendered and written there whenever no block
+    // is open and the tree has grown past flushThreshold, so memory stays
+    // bounded by the largest block.
+    void parseLines(LineSource &source, ostream *out)
+    {
+        StageTimer timer(profile, Stage::Blocks);
+        const size_t flushThreshold = 64 * 1024;
+        string_view line, next;
+        bool plain = false, nextPlain = false;
+        bool hasLine = readLine(source, line, plain);
+        bool hasNext = hasLine && readLine(source, next, nextPlain);
+        string html;
+
+        while (hasLine)
+        {
+            // Lines from a stream are reused; the tree needs its own copy
+            string_view kept = source.persistent() ? line : arena.copy(line);
+            int advance = parseLine(kept, plain, hasNext ? &next : nullptr) ? 2 : 1;
+            for (int step = 0; step < advance && hasLine; step++)
+            {
+                swap(line, next);
+                plain = nextPlain;
+                hasLine = hasNext;
+                hasNext = hasLine && readLine(source, next, nextPlain);
+            }
+
+            // Lists and code blocks are written whole; an open table can be
+            // written a run of rows at a time
+            if (out != nullptr && openLists.empty() && openCode == nullptr && arena.bytesUsed() >= flushThreshold)
+            {
+                renderDocument(html);
+                StageTimer writeTimer(profile, Stage::Write);
+                out->write(html.data(), static_cast<streamsize>(html.length()));
+                html.clear();
+            }
+        }
+
+        closeBlocks();
+    }
+
+    // Parses markdown and renders its body into html; TOC entries and
+    // footnotes are left in the converter.
+    void convertBody(string_view markdown, string &html)
+    {
+        beginDocument();
+        DocumentLines source(markdown);
+        parseLines(source, nullptr);
+
+        html.reserve(markdown.length() + markdown.length() / 4);
+        renderDocument(html);
+    }
+
+    // Offsets where markdown can be cut into pieces that parse on their
+    // own: just after a blank line outside fenced code. A blank line closes
+    // every list and table, so no parser state crosses such a cut. At most
+    // pieces - 1 cuts are returned, each at or after the next even share.
+    vector<size_t> findSplitPoints(string_view markdown, size_t pieces)
+    {
+        vector<size_t> splits;
+        size_t share = markdown.length() / pieces;
+        bool inFence = false;
+        size_t pos = 0;
+        while (pos < markdown.length() && splits.size() + 1 < pieces)
+        {
+            size_t newline = markdown.find('\n', pos);
+            size_t lineEnd = newline == string_view::npos ? markdown.length() : newline;
+            string_view line = trim(markdown.substr(pos, lineEnd - pos));
+            pos = lineEnd + 1;
+            if (line.substr(0, 3) == "```")
+                inFence = !inFence;
+            else if (line.empty() && !inFence && pos >= share * (splits.size() + 1) && pos < markdown.length())
+                splits.push_back(pos);
+        }
+        return splits;
+    }
+
+    // Converts the pieces between splits on their own converters, one
+    // thread each, then merges TOC entries and footnotes in document order.
+    void convertParallel(string_view markdown, const vector<size_t> &splits, OutputBuffer &out)
+    {
+        size_t count = splits.size() + 1;
+        vector<unique_ptr<DocumentContext>> parts;
+        vector<string> bodies(count);
+        vector<exception_ptr> errors(count);
+        vector<SearchIndex> partIndexes(searchIndex != nullptr ? count : 0);
+        for (size_t k = 0; k < count; k++)
+        {
+            parts.push_back(make_unique<DocumentContext>());
+            parts.back()->limits = limits;
+            if (searchIndex != nullptr)
+                parts.back()->searchIndex = &partIndexes[k];
+        }
+
+        auto convertPart = [&](size_t k)
+        {
+            size_t begin = k == 0 ? 0 : splits[k - 1];
+            size_t end = k < splits.size() ? splits[k] : markdown.length();
+            try
+            {
+                parts[k]->convertBody(markdown.substr(begin, end - begin), bodies[k]);
+            }
+            catch (...)
+            {
+                errors[k] = current_exception();
+            }
+        };
+
+        vector<thread> workers;
+        for (size_t k = 1; k < count; k++)
+            workers.emplace_back(convertPart, k);
+        convertPart(0);
+        for (thread &worker : workers)
+            worker.join();
+        for (const exception_ptr &error : errors)
+        {
+            if (error)
+                rethrow_exception(error);
+        }
+
+        beginDocument();
+        for (SearchIndex &partIndex : partIndexes)
+            searchIndex->merge(move(partIndex), true);
+        for (const auto &part : parts)
+        {
+            tocEntries.insert(tocEntries.end(), part->tocEntries.begin(), part->tocEntries.end());
+            features |= part->features;
+            // Later definitions win, as they do in a single pass
+            for (const auto &note : part->footnotes)
+            {
+                if (footnotes.size() < limits.maxFootnotes || footnotes.count(note.first) != 0)
+                    footnotes[note.first] = note.second;
+            }
+        }
+
+        out.append(generateTOC());
+        for (string &body : bodies)
+            out.append(move(body));
+        out.append(generateFootnotes());
+    }
+
+    // Documents smaller than this are not worth splitting across threads
+    static constexpr size_t parallelThreshold = 1024 * 1024;
+    unsigned threads = 1;
+
+    void configure(const ConverterLimits &newLimits, Profile *activeProfile, unsigned threadCount)
+    {
+        limits = newLimits;
+        profile = activeProfile;
+        threads = threadCount;
+    }
+
+    // Parses markdown and adds it to the search index without rendering it
+    void indexDocument(string_view markdown)
+    {
+        beginDocument();
+        DocumentLines source(markdown);
+        parseLines(source, nullptr);
+        StageTimer timer(profile, Stage::Index);
+        indexBlocks(document.first);
+    }
+
+public:
+    // PageFeature bits of the last converted document, for the page template
+    unsigned usedFeatures() const
+    {
+        return features;
+    }
+
+    // Appends the TOC, body and footnotes to out without joining them.
+    void convertToHTML(string_view markdown, OutputBuffer &out)
+    {
+        if (threads > 1 && markdown.length() >= parallelThreshold)
+        {
+            vector<size_t> splits = findSplitPoints(markdown, threads);
+            if (!splits.empty())
+            {
+                convertParallel(markdown, splits, out);
+                return;
+            }
+        }
+
+        string html;
+        convertBody(markdown, html);
+
+        // Add TOC at the beginning
+        out.append(generateTOC());
+        out.append(move(html));
+
+        // Add footnotes at the end
+        out.append(generateFootnotes());
+    }
+
+    string convertToHTML(string_view markdown)
+    {
+        OutputBuffer out;
+        convertToHTML(markdown, out);
+        return out.str();
+    }
+
+    // Converts markdown read from in, writing HTML to out as blocks complete.
+    // The table of contents is only known at the end: it goes to tocOut when
+    // given, otherwise it is written after the body with a placeholder at the
+    // top that the page script moves it into. Returns the bytes read.
+    size_t convertStream(istream &in, ostream &out, ostream *tocOut = nullptr)
+    {
+        if (tocOut == nullptr)
+            out << "<div id=\"toc-placeholder\"></div>\n";
+
+        beginDocument();
+        StreamLines source(in);
+        parseLines(source, &out);
+
+        string html;
+        renderDocument(html);
+        string notes = generateFootnotes();
+        string toc = generateTOC();
+
+        StageTimer timer(profile, Stage::Write);
+        out << html << notes;
+        if (tocOut != nullptr)
+            *tocOut << toc;
+        else if (!toc.empty())
+            out << "<div id=\"toc-deferred\">\n" << toc << "</div>\n";
+
+        return source.bytesRead();
+    }
+};
+
+// The converter's settings. Converting does not change them, so one
+// converter can be shared by every thread without locking: each call
+// parses in the calling thread's own DocumentContext, which is kept from
+// one call to the next. Configure the converter before sharing it.
+class MarkdownConverter
+{
+private:
+    ConverterLimits limits;
+    Profile *profile = nullptr;
+    unsigned threads = 1;
+
+    DocumentContext &context() const
+    {
+        static thread_local DocumentContext local;
+        local.configure(limits, profile, threads);
+        return local;
+    }
+
+public:
+    // Number of threads convertToHTML may split a large document across.
+    void setThreads(unsigned count)
+    {
+        threads = max(1u, count);
+    }
+
+    void setLimits(const ConverterLimits &newLimits)
+    {
+        limits = newLimits;
+    }
+
+    // Stage times and counts go to activeProfile, or nowhere when null.
+    // Profiled documents are converted on one thread, one at a time.
+    void setProfile(Profile *activeProfile)
+    {
+        profile = activeProfile;
+    }
+
+    // Appends the TOC, body and footnotes to out without joining them. The
+    // PageFeature bits the document uses go to features when given, and its
+    // text to index, into the document last begun there.
+    void convertToHTML(string_view markdown, OutputBuffer &out, unsigned *features = nullptr,
+                       SearchIndex *index = nullptr) const
+    {
+        DocumentContext &document = context();
+        document.searchIndex = index;
+        document.convertToHTML(markdown, out);
+        if (features != nullptr)
+            *features = document.usedFeatures();
+        document.endDocument();
+    }
+
+    string convertToHTML(string_view markdown) const
+    {
+        OutputBuffer out;
+        convertToHTML(markdown, out);
+        return out.str();
+    }
+
+    // See DocumentContext::convertStream. Returns the bytes read.
+    size_t convertStream(istream &in, ostream &out, ostream *tocOut = nullptr, unsigned *features = nullptr,
+                         SearchIndex *index = nullptr) const
+    {
+        DocumentContext &document = context();
+        document.searchIndex = index;
+        size_t length = document.convertStream(in, out, tocOut);
+        if (features != nullptr)
+            *features = document.usedFeatures();
+        document.endDocument();
+        return length;
+    }
+
+    // Adds markdown to index as convertToHTML would, without rendering it:
+    // for pages taken from the conversion cache.
+    void indexDocument(string_view markdown, SearchIndex &index) const
+    {
+        DocumentContext &document = context();
+        document.searchIndex = &index;
+        document.indexDocument(markdown);
+        document.endDocument();
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Incremental rendering
+//
+// For live previews: the document is kept as a list of segments, each cut
+// just after a blank line outside fenced code (the same safe cuts used for
+// parallel conversion), so every segment converts on its own. An edit only
+// re-parses the segments it touches, and a segment whose text hashes the
+// same as one it replaces reuses that segment's HTML.
+// ---------------------------------------------------------------------------
+
+// What an edit changed: segments [first, first + removed) of the previous
+// rendering were replaced by fragments, in order.
+struct RenderPatch
+{
+    size_t first = 0;
+    size_t removed = 0;
+    vector<string> fragments;
+    bool tocChanged = false;
+    bool footnotesChanged = false;
+};
+
+class IncrementalDocument
+{
+private:
+    struct Segment
+    {
+        size_t length;
+        uint64_t hash;
+        string html;
+        vector<TocEntry> toc;
+        vector<pair<string, string>> footnotes;
+    };
+
+    string text;
+    vector<Segment> segments;
+    DocumentContext converter;
+
+    static uint64_t hashText(string_view data)
+    {
+        uint64_t h = 1469598103934665603ull;
+        for (char c : data)
+        {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    static bool sameEntries(const vector<TocEntry> &a, const vector<TocEntry> &b)
+    {
+        return equal(a.begin(), a.end(), b.begin(), b.end(), [](const TocEntry &x, const TocEntry &y)
+                     { return x.level == y.level && x.id == y.id && x.text == y.text; });
+    }
+
+    // End of the segment starting at pos: the start of the first non-blank
+    // line after a blank line outside fenced code, or the end of the text.
+    size_t segmentEnd(size_t pos) const
+    {
+        bool inFence = false;
+        bool sawBlank = false;
+        while (pos < text.length())
+        {
+            size_t newline = text.find('\n', pos);
+            size_t lineEnd = newline == string::npos ? text.length() : newline;
+            string_view line = converter.trim(string_view(text).substr(pos, lineEnd - pos));
+            if (sawBlank && !line.empty())
+                return pos;
+            if (line.substr(0, 3) == "```")
+                inFence = !inFence;
+            else if (line.empty() && !inFence)
+                sawBlank = true;
+            pos = min(lineEnd + 1, text.length());
+        }
+        return text.length();
+    }
+
+    Segment renderSegment(size_t start, size_t end)
+    {
+        string_view part = string_view(text).substr(start, end - start);
+        Segment segment{part.length(), hashText(part), string(), {}, {}};
+        converter.convertBody(part, segment.html);
+        segment.toc = move(converter.tocEntries);
+        segment.footnotes.assign(converter.footnotes.begin(), converter.footnotes.end());
+        return segment;
+    }
+
+public:
+    explicit IncrementalDocument(string markdown = string())
+    {
+        setText(move(markdown));
+    }
+
+    const string &markdown() const { return text; }
+    size_t segmentCount() const { return segments.size(); }
+
+    void setText(string markdown)
+    {
+        text = move(markdown);
+        segments.clear();
+        for (size_t pos = 0; pos < text.length();)
+        {
+            size_t end = segmentEnd(pos);
+            segments.push_back(renderSegment(pos, end));
+            pos = end;
+        }
+    }
+
+    // Replaces removed bytes at offset with inserted. Segments are re-cut
+    // from the one holding offset until a cut lines up with an old segment
+    // boundary again; only those segments are converted, and only when their
+    // text differs from every segment they replace.
+    RenderPatch edit(size_t offset, size_t removed, string_view inserted)
+    {
+        offset = min(offset, text.length());
+        removed = min(removed, text.length() - offset);
+
+        // Segment holding offset (the last one for an edit at the very end)
+        size_t first = 0;
+        size_t start = 0;
+        while (first + 1 < segments.size() && start + segments[first].length <= offset)
+            start += segments[first++].length;
+
+        text.replace(offset, removed, inserted.data(), inserted.length());
+        size_t newEditEnd = offset + inserted.length();
+
+        vector<Segment> fresh;
+        size_t last = first; // Old segments [first, last) are covered
+        size_t oldEnd = start;
+        size_t pos = start;
+        while (pos < text.length())
+        {
+            size_t end = segmentEnd(pos);
+            string_view part = string_view(text).substr(pos, end - pos);
+            uint64_t hash = hashText(part);
+
+            // Reuse a replaced segment with the same text
+            const Segment *match = nullptr;
+            for (size_t k = first; k < segments.size() && k <= last + 1 && match == nullptr; k++)
+            {
+                if (segments[k].hash == hash && segments[k].length == part.length())
+                    match = &segments[k];
+            }
+            fresh.push_back(match != nullptr ? *match : renderSegment(pos, end));
+            pos = end;
+
+            // Past the edit, a cut on an old boundary means the rest is unchanged
+            if (pos >= newEditEnd)
+            {
+                size_t oldPos = pos + removed - inserted.length();
+                while (last < segments.size() && oldEnd + segments[last].length <= oldPos)
+                    oldEnd += segments[last++].length;
+                if (oldEnd == oldPos)
+                    break;
+            }
+        }
+        if (pos >= text.length())
+            last = segments.size();
+
+        RenderPatch patch;
+        patch.first = first;
+        patch.removed = last - first;
+        vector<TocEntry> oldToc, newToc;
+        vector<pair<string, string>> oldNotes, newNotes;
+        for (size_t k = first; k < last; k++)
+        {
+            oldToc.insert(oldToc.end(), segments[k].toc.begin(), segments[k].toc.end());
+            oldNotes.insert(oldNotes.end(), segments[k].footnotes.begin(), segments[k].footnotes.end());
+        }
+        for (const Segment &segment : fresh)
+        {
+            newToc.insert(newToc.end(), segment.toc.begin(), segment.toc.end());
+            newNotes.insert(newNotes.end(), segment.footnotes.begin(), segment.footnotes.end());
+            patch.fragments.push_back(segment.html);
+        }
+        patch.tocChanged = !sameEntries(oldToc, newToc);
+        patch.footnotesChanged = oldNotes != newNotes;
+
+        if (fresh.size() == last - first)
+            move(fresh.begin(), fresh.end(), segments.begin() + first); // The usual keystroke: no shifting
+        else
+        {
+            segments.erase(segments.begin() + first, segments.begin() + last);
+            segments.insert(segments.begin() + first, make_move_iterator(fresh.begin()), make_move_iterator(fresh.end()));
+        }
+        return patch;
+    }
+
+    const string &fragment(size_t index) const { return segments[index].html; }
+
+    string tocHtml()
+    {
+        converter.tocEntries.clear();
+        for (const Segment &segment : segments)
+            converter.tocEntries.insert(converter.tocEntries.end(), segment.toc.begin(), segment.toc.end());
+        return converter.generateTOC();
+    }
+
+    string footnotesHtml()
+    {
+        // Later definitions win, as they do in a single pass
+        converter.footnotes.clear();
+        for (const Segment &segment : segments)
+        {
+            for (const auto &note : segment.footnotes)
+                converter.footnotes[note.first] = note.second;
+        }
+        return converter.generateFootnotes();
+    }
+
+    // The whole document, identical to MarkdownConverter::convertToHTML
+    void html(OutputBuffer &out)
+    {
+        out.append(tocHtml());
+        for (const Segment &segment : segments)
+            out.appendStatic(segment.html);
+        out.append(footnotesHtml());
+    }
+
+    string html()
+    {
+        OutputBuffer out;
+        html(out);
+        return out.str();
+    }
+};
+
+bool fileExists(const string &filename)
+{
+    ifstream file(filename);
+    return file.good();
+}
+
+// Read-only view of a whole file. Mapped into memory where mmap is
+// available, so the document is never copied; read into a string otherwise.
+class MappedFile
+{
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+#ifdef MD2HTML_POSIX
+    void *mapping = nullptr;
+#endif
+    string fallback;
+
+public:
+    explicit MappedFile(const string &filename)
+    {
+#ifdef MD2HTML_POSIX
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+        {
+            size = static_cast<size_t>(info.st_size);
+            if (size > 0)
+            {
+                mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping != MAP_FAILED)
+                {
+                    madvise(mapping, size, MADV_SEQUENTIAL);
+                    data = static_cast<const char *>(mapping);
+                    opened = true;
+                }
+                else
+                {
+                    mapping = nullptr;
+                    size = 0;
+                }
+            }
+            else
+                opened = true;
+        }
+        close(fd);
+        if (opened)
+            return;
+#endif
+        // Pipes, special files and platforms without mmap
+        ifstream file(filename, ios::binary);
+        if (!file.is_open())
+            return;
+        ostringstream buffer;
+        buffer << file.rdbuf();
+        fallback = buffer.str();
+        data = fallback.data();
+        size = fallback.length();
+        opened = true;
+    }
+
+    ~MappedFile()
+    {
+#ifdef MD2HTML_POSIX
+        if (mapping != nullptr)
+            munmap(mapping, size);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const { return opened; }
+    string_view view() const { return string_view(data, size); }
+};
+
+// ---------------------------------------------------------------------------
+// Page template
+//
+// The page around the converted content is made of constant segments that
+// are written out as they are. The stylesheet and script are either inlined
+// into every page or, with --css external, written once as md2html.css and
+// md2html.js and linked. --minify swaps every segment for a minified copy,
+// made once per process. Highlight.js and MathJax are loaded at the end of
+// the body, and only for documents with code blocks or math.
+// ---------------------------------------------------------------------------
+
+static const char pageStart[] =
+    "<!DOCTYPE html>\n"
+    "<html lang=\"en\">\n"
+    "<head>\n"
+    "  <meta charset=\"UTF-8\">\n"
+    "  <meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n"
+    "  <title>";
+
+static const char pageTitleEnd[] =
+    "</title>\n";
+
+static const char pageStyle[] =
+    "    :root {\n"
+    "      --bg-color: #ffffff;\n"
+    "      --text-color: #333333;\n"
+    "      --border-color: #dddddd;\n"
+    "      --code-bg: #f4f4f4;\n"
+    "      --blockquote-border: #dddddd;\n"
+    "      --table-border: #dddddd;\n"
+    "      --code-keyword: #d73a49;\n"
+    "      --code-type: #6f42c1;\n"
+    "      --code-number: #005cc5;\n"
+    "      --code-string: #032f62;\n"
+    "      --code-comment: #6a737d;\n"
+    "      --code-meta: #e36209;\n"
+    "    }\n"
+    "    \n"
+    "    [data-theme=\"dark\"] {\n"
+    "      --bg-color: #1a1a1a;\n"
+    "      --text-color: #e0e0e0;\n"
+    "      --border-color: #444444;\n"
+    "      --code-bg: #2d2d2d;\n"
+    "      --blockquote-border: #555555;\n"
+    "      --table-border: #555555;\n"
+    "      --code-keyword: #ff7b72;\n"
+    "      --code-type: #d2a8ff;\n"
+    "      --code-number: #79c0ff;\n"
+    "      --code-string: #a5d6ff;\n"
+    "      --code-comment: #8b949e;\n"
+    "      --code-meta: #ffa657;\n"
+    "    }\n"
+    "    \n"
+    "    body {\n"
+    "      font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, 'Helvetica Neue', Arial, sans-serif;\n"
+    "      max-width: 900px;\n"
+    "      margin: 0 auto;\n"
+    "      padding: 20px;\n"
+    "      line-height: 1.6;\n"
+    "      background-color: var(--bg-color);\n"
+    "      color: var(--text-color);\n"
+    "      transition: background-color 0.3s, color 0.3s;\n"
+    "    }\n"
+    "    \n"
+    "    .theme-toggle {\n"
+    "      position: fixed;\n"
+    "      top: 20px;\n"
+    "      right: 20px;\n"
+    "      background: var(--code-bg);\n"
+    "      border: 1px solid var(--border-color);\n"
+    "      border-radius: 50px;\n"
+    "      padding: 10px 15px;\n"
+    "      cursor: pointer;\n"
+    "      font-size: 16px;\n"
+    "      transition: all 0.3s;\n"
+    "    }\n"
+    "    \n"
+    "    .theme-toggle:hover {\n"
+    "      transform: scale(1.1);\n"
+    "    }\n"
+    "    \n"
+    "    code {\n"
+    "      background-color: var(--code-bg);\n"
+    "      padding: 2px 6px;\n"
+    "      border-radius: 4px;\n"
+    "      font-family: 'SF Mono', Monaco, 'Cascadia Code', 'Roboto Mono', Consolas, 'Courier New', monospace;\n"
+    "      font-size: 0.9em;\n"
+    "    }\n"
+    "    \n"
+    "    pre {\n"
+    "      background-color: var(--code-bg);\n"
+    "      padding: 16px;\n"
+    "      border-radius: 8px;\n"
+    "      overflow-x: auto;\n"
+    "      border: 1px solid var(--border-color);\n"
+    "    }\n"
+    "    \n"
+    "    pre code {\n"
+    "      background: none;\n"
+    "      padding: 0;\n"
+    "    }\n"
+    "    \n"
+    "    .hljs-keyword { color: var(--code-keyword); }\n"
+    "    .hljs-type, .hljs-built_in { color: var(--code-type); }\n"
+    "    .hljs-literal, .hljs-number, .hljs-attr { color: var(--code-number); }\n"
+    "    .hljs-string { color: var(--code-string); }\n"
+    "    .hljs-comment { color: var(--code-comment); font-style: italic; }\n"
+    "    .hljs-meta, .hljs-variable { color: var(--code-meta); }\n"
+    "    \n"
+    "    blockquote {\n"
+    "      border-left: 4px solid var(--blockquote-border);\n"
+    "      margin: 0;\n"
+    "      padding-left: 20px;\n"
+    "      color: var(--text-color);\n"
+    "      opacity: 0.8;\n"
+    "      font-style: italic;\n"
+    "    }\n"
+    "    \n"
+    "    hr {\n"
+    "      border: none;\n"
+    "      border-top: 2px solid var(--border-color);\n"
+    "      margin: 30px 0;\n"
+    "    }\n"
+    "    \n"
+    "    img {\n"
+    "      max-width: 100%;\n"
+    "      height: auto;\n"
+    "      border-radius: 8px;\n"
+    "      box-shadow: 0 4px 8px rgba(0,0,0,0.1);\n"
+    "    }\n"
+    "    \n"
+    "    ul, ol {\n"
+    "      padding-left: 25px;\n"
+    "    }\n"
+    "    \n"
+    "    li {\n"
+    "      margin: 8px 0;\n"
+    "    }\n"
+    "    \n"
+    "    .task-list {\n"
+    "      list-style: none;\n"
+    "      padding-left: 0;\n"
+    "    }\n"
+    "    \n"
+    "    .task-item {\n"
+    "      display: flex;\n"
+    "      align-items: center;\n"
+    "      margin: 8px 0;\n"
+    "    }\n"
+    "    \n"
+    "    .task-item input[type=\"checkbox\"] {\n"
+    "      margin-right: 8px;\n"
+    "      transform: scale(1.2);\n"
+    "    }\n"
+    "    \n"
+    "    table {\n"
+    "      width: 100%;\n"
+    "      border-collapse: collapse;\n"
+    "      margin: 20px 0;\n"
+    "      border: 1px solid var(--table-border);\n"
+    "      border-radius: 8px;\n"
+    "      overflow: hidden;\n"
+    "    }\n"
+    "    \n"
+    "    th, td {\n"
+    "      padding: 12px 15px;\n"
+    "      text-align: left;\n"
+    "      border-bottom: 1px solid var(--table-border);\n"
+    "    }\n"
+    "    \n"
+    "    th {\n"
+    "      background-color: var(--code-bg);\n"
+    "      font-weight: 600;\n"
+    "    }\n"
+    "    \n"
+    "    tr:hover {\n"
+    "      background-color: var(--code-bg);\n"
+    "    }\n"
+    "    \n"
+    "    .toc {\n"
+    "      background-color: var(--code-bg);\n"
+    "      padding: 20px;\n"
+    "      border-radius: 8px;\n"
+    "      margin-bottom: 30px;\n"
+    "      border: 1px solid var(--border-color);\n"
+    "    }\n"
+    "    \n"
+    "    .toc h2 {\n"
+    "      margin-top: 0;\n"
+    "      color: var(--text-color);\n"
+    "    }\n"
+    "    \n"
+    "    .toc ul {\n"
+    "      list-style-type: none;\n"
+    "      padding-left: 0;\n"
+    "    }\n"
+    "    \n"
+    "    .toc li {\n"
+    "      margin: 5px 0;\n"
+    "    }\n"
+    "    \n"
+    "    .toc a {\n"
+    "      text-decoration: none;\n"
+    "      color: var(--text-color);\n"
+    "      opacity: 0.8;\n"
+    "      transition: opacity 0.3s;\n"
+    "    }\n"
+    "    \n"
+    "    .toc a:hover {\n"
+    "      opacity: 1;\n"
+    "      text-decoration: underline;\n"
+    "    }\n"
+    "    \n"
+    "    .footnotes {\n"
+    "      margin-top: 40px;\n"
+    "      padding-top: 20px;\n"
+    "      border-top: 1px solid var(--border-color);\n"
+    "    }\n"
+    "    \n"
+    "    .footnote-backref {\n"
+    "      text-decoration: none;\n"
+    "      font-size: 0.8em;\n"
+    "      margin-left: 5px;\n"
+    "    }\n"
+    "    \n"
+    "    .math-inline {\n"
+    "      font-family: 'Times New Roman', serif;\n"
+    "    }\n"
+    "    \n"
+    "    .math-block {\n"
+    "      text-align: center;\n"
+    "      margin: 20px 0;\n"
+    "      font-family: 'Times New Roman', serif;\n"
+    "    }\n"
+    "    \n"
+    "    h1, h2, h3, h4, h5, h6 {\n"
+    "      margin-top: 2em;\n"
+    "      margin-bottom: 0.5em;\n"
+    "      font-weight: 600;\n"
+    "    }\n"
+    "    \n"
+    "    h1 { font-size: 2.2em; }\n"
+    "    h2 { font-size: 1.8em; }\n"
+    "    h3 { font-size: 1.5em; }\n"
+    "    h4 { font-size: 1.3em; }\n"
+    "    h5 { font-size: 1.1em; }\n"
+    "    h6 { font-size: 1em; }\n"
+    "    \n"
+    "    a {\n"
+    "      color: #0066cc;\n"
+    "      text-decoration: none;\n"
+    "    }\n"
+    "    \n"
+    "    a:hover {\n"
+    "      text-decoration: underline;\n"
+    "    }\n"
+    "    \n"
+    "    [data-theme=\"dark\"] a {\n"
+    "      color: #66b3ff;\n"
+    "    }\n";
+
+static const char pageBodyStart[] =
+    "</head>\n"
+    "<body>\n"
+    "  <button class=\"theme-toggle\" onclick=\"toggleTheme()\">🌓</button>\n"
+    "  \n";
+
+// Run after Highlight.js has loaded
+static const char pageHighlightInit[] =
+    "  <script>hljs.highlightAll();</script>\n";
+
+// Read by MathJax when it starts
+static const char pageMathConfig[] =
+    "  <script>\n"
+    "    window.MathJax = {\n"
+    "      tex: {\n"
+    "        inlineMath: [['$', '$']],\n"
+    "        displayMath: [['$$', '$$']]\n"
+    "      }\n"
+    "    };\n"
+    "  </script>\n";
+
+static const char pageScript[] =
+    "    // Dark mode toggle\n"
+    "    function toggleTheme() {\n"
+    "      const body = document.body;\n"
+    "      const currentTheme = body.getAttribute('data-theme');\n"
+    "      body.setAttribute('data-theme', currentTheme === 'dark' ? 'light' : 'dark');\n"
+    "      localStorage.setItem('theme', body.getAttribute('data-theme'));\n"
+    "    }\n"
+    "    \n"
+    "    // Move a table of contents written after a streamed body into place\n"
+    "    (function() {\n"
+    "      const toc = document.getElementById('toc-deferred');\n"
+    "      const slot = document.getElementById('toc-placeholder');\n"
+    "      if (toc && slot) slot.replaceWith(toc);\n"
+    "    })();\n"
+    "    \n"
+    "    // Persist theme across reloads\n"
+    "    (function() {\n"
+    "      const savedTheme = localStorage.getItem('theme') || 'light';\n"
+    "      document.body.setAttribute('data-theme', savedTheme);\n"
+    "    })();\n";
+
+static const char pageEnd[] =
+    "</body>\n"
+    "</html>";
+
+// Where the third-party assets come from: their CDNs, copies of
+// --vendor-dir linked from the page, or the same copies inlined into it
+enum class AssetSource : uint8_t
+{
+    Cdn,
+    Local,
+    Inline
+};
+
+struct VendorAsset
+{
+    const char *file; // Name in the vendor directory
+    const char *url;  // Location on the CDN
+    unsigned feature; // PageFeature that needs it
+};
+
+static const VendorAsset vendorAssets[] = {
+    {"highlight.min.css", "https://cdnjs.cloudflare.com/ajax/libs/highlight.js/11.9.0/styles/default.min.css", FeatureCode},
+    {"highlight.min.js", "https://cdnjs.cloudflare.com/ajax/libs/highlight.js/11.9.0/highlight.min.js", FeatureCode},
+    {"tex-mml-chtml.js", "https://cdn.jsdelivr.net/npm/mathjax@3/es5/tex-mml-chtml.js", FeatureMath},
+};
+
+static const size_t vendorAssetCount = sizeof(vendorAssets) / sizeof(vendorAssets[0]);
+
+// How a page gets its stylesheet and scripts
+struct PageOptions
+{
+    bool externalAssets = false; // Link md2html.css and md2html.js instead of inlining them
+    bool minify = false;
+    fs::path assetDirectory;     // Where md2html.css and md2html.js are written
+    string assetPath;            // URL prefix from the page to assetDirectory, "" or ending in '/'
+    AssetSource vendor = AssetSource::Cdn;
+    fs::path vendorDirectory;
+    shared_ptr<const vector<string>> vendored; // Contents of vendorAssets, for AssetSource::Inline
+};
+
+// Drops comments, indentation and line breaks, and the spaces around CSS
+// punctuation. Enough for the stylesheet above; not a general minifier.
+static string minifyCss(string_view css)
+{
+    string out;
+    out.reserve(css.length());
+    bool space = false;
+    for (size_t i = 0; i < css.length(); i++)
+    {
+        char c = css[i];
+        if (c == '/' && i + 1 < css.length() && css[i + 1] == '*')
+        {
+            size_t end = css.find("*/", i + 2);
+            i = end == string_view::npos ? css.length() : end + 1;
+            continue;
+        }
+        if (isspace(static_cast<unsigned char>(c)))
+        {
+            space = true;
+            continue;
+        }
+        if (space && !out.empty() && strchr("{};:,>", out.back()) == nullptr && strchr("{};:,>", c) == nullptr)
+            out += ' ';
+        space = false;
+        // The last declaration of a rule needs no semicolon
+        if (c == '}' && !out.empty() && out.back() == ';')
+            out.pop_back();
+        out += c;
+    }
+    return out;
+}
+
+// Drops whole-line comments, indentation and blank lines; line breaks stay
+// so automatic semicolon insertion sees the same statements.
+static string minifyScript(string_view script)
+{
+    string out;
+    out.reserve(script.length());
+    size_t pos = 0;
+    while (pos < script.length())
+    {
+        size_t end = script.find('\n', pos);
+        if (end == string_view::npos)
+            end = script.length();
+        size_t start = script.find_first_not_of(" \t", pos);
+        if (start < end && script.compare(start, 2, "//") != 0)
+        {
+            out.append(script.substr(start, end - start));
+            out += '\n';
+        }
+        pos = end + 1;
+    }
+    return out;
+}
+
+// Drops line breaks and indentation between tags.
+static string minifyMarkup(string_view markup)
+{
+    string out;
+    out.reserve(markup.length());
+    for (size_t i = 0; i < markup.length(); i++)
+    {
+        if (markup[i] == '\n' || (i == 0 && markup[i] == ' '))
+        {
+            while (i + 1 < markup.length() && markup[i + 1] == ' ')
+                i++;
+            continue;
+        }
+        out += markup[i];
+    }
+    return out;
+}
+
+struct PageTemplate
+{
+    string start, titleEnd, styleOpen, style, styleClose, bodyStart;
+    string contentEnd, highlightInit, mathConfig, scriptOpen, script, scriptClose, end;
+};
+
+static PageTemplate buildPageTemplate(bool minify)
+{
+    PageTemplate page{pageStart, pageTitleEnd, "  <style>\n", pageStyle, "  </style>\n", pageBodyStart,
+                      "\n  \n", pageHighlightInit, pageMathConfig, "  <script>\n", pageScript, "  </script>\n", pageEnd};
+    if (minify)
+    {
+        page.mathConfig = minifyScript(page.mathConfig);
+        for (string *markup : {&page.start, &page.titleEnd, &page.styleOpen, &page.styleClose, &page.bodyStart,
+                               &page.contentEnd, &page.highlightInit, &page.mathConfig, &page.scriptOpen,
+                               &page.scriptClose, &page.end})
+            *markup = minifyMarkup(*markup);
+        page.style = minifyCss(page.style);
+        page.script = minifyScript(page.script);
+    }
+    return page;
+}
+
+static const PageTemplate &pageTemplate(bool minify)
+{
+    static const PageTemplate pretty = buildPageTemplate(false);
+    static const PageTemplate minified = buildPageTemplate(true);
+    return minify ? minified : pretty;
+}
+
+// Writes md2html.css and md2html.js for --css external, and copies the
+// vendor directory for --assets local, into options.assetDirectory
+bool writePageAssets(const PageOptions &options)
+{
+    const fs::path &directory = options.assetDirectory;
+    error_code ec;
+    if (options.vendor == AssetSource::Local)
+    {
+        fs::path target = directory / "vendor";
+        if (!fs::equivalent(options.vendorDirectory, target, ec))
+        {
+            fs::create_directories(target, ec);
+            ec.clear();
+            fs::copy(options.vendorDirectory, target, fs::copy_options::recursive | fs::copy_options::update_existing, ec);
+            if (ec)
+            {
+                cerr << "Error: Cannot copy '" << options.vendorDirectory.string() << "' to '" << target.string()
+                     << "': " << ec.message() << "\n";
+                return false;
+            }
+        }
+    }
+    if (!options.externalAssets)
+        return true;
+
+    const PageTemplate &page = pageTemplate(options.minify);
+    fs::create_directories(directory, ec);
+    for (const auto &asset : {make_pair("md2html.css", &page.style), make_pair("md2html.js", &page.script)})
+    {
+        ofstream file(directory / asset.first, ios::binary);
+        if (!file.is_open() || !file.write(asset.second->data(), static_cast<streamsize>(asset.second->length())))
+        {
+            cerr << "Error: Cannot write '" << (directory / asset.first).string() << "'.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads the vendored assets for --assets inline, or checks they are there
+// for --assets local
+bool loadVendorAssets(PageOptions &options)
+{
+    if (options.vendor == AssetSource::Cdn)
+        return true;
+    if (options.vendorDirectory.empty())
+    {
+        cerr << "Error: --assets " << (options.vendor == AssetSource::Local ? "local" : "inline")
+             << " needs --vendor-dir.\n";
+        return false;
+    }
+
+    auto contents = make_shared<vector<string>>();
+    for (const VendorAsset &asset : vendorAssets)
+    {
+        fs::path path = options.vendorDirectory / asset.file;
+        ifstream file(path, ios::binary);
+        if (!file.is_open())
+        {
+            cerr << "Error: Cannot read vendored asset '" << path.string() << "'.\n";
+            return false;
+        }
+        if (options.vendor == AssetSource::Inline)
+        {
+            string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+            // Neither may end the element it is inlined into
+            const char *closer = strstr(asset.file, ".css") != nullptr ? "</style" : "</script";
+            for (size_t at = text.find(closer); at != string::npos; at = text.find(closer, at + 2))
+                text.insert(at + 1, 1, '\\');
+            contents->push_back(move(text));
+        }
+    }
+    options.vendored = move(contents);
+    return true;
+}
+
+// URL prefix from a page in pageDir to the assets in assetDir
+string assetPathFor(const fs::path &assetDir, const fs::path &pageDir)
+{
+    fs::path relative = fs::absolute(assetDir).lexically_normal().lexically_relative(fs::absolute(pageDir).lexically_normal());
+    string path = relative.generic_string();
+    return path.empty() || path == "." ? string() : path + "/";
+}
+
+// The URL of one of our assets from the page, escaped for an attribute;
+// assetPath may come from a library caller
+static string assetUrl(const PageOptions &options, const char *file)
+{
+    string url;
+    appendHtmlEscaped(url, options.assetPath.data(), options.assetPath.length(), true);
+    url += file;
+    return url;
+}
+
+void appendHtmlHeader(OutputBuffer &out, const string &title = "Converted Document", const PageOptions &options = PageOptions())
+{
+    const PageTemplate &page = pageTemplate(options.minify);
+    out.appendStatic(page.start);
+    string escapedTitle;
+    appendHtmlEscaped(escapedTitle, title.data(), title.length());
+    out.append(move(escapedTitle));
+    out.appendStatic(page.titleEnd);
+    if (options.externalAssets)
+        out.append(string(options.minify ? "" : "  ") + "<link rel=\"stylesheet\" href=\"" + assetUrl(options, "md2html.css") + "\">" +
+                   (options.minify ? "" : "\n"));
+    else
+    {
+        out.appendStatic(page.styleOpen);
+        out.appendStatic(page.style);
+        out.appendStatic(page.styleClose);
+    }
+    out.appendStatic(page.bodyStart);
+}
+
+static void appendVendorAsset(OutputBuffer &out, size_t index, const PageOptions &options)
+{
+    const VendorAsset &asset = vendorAssets[index];
+    bool css = strstr(asset.file, ".css") != nullptr;
+    const char *indent = options.minify ? "" : "  ";
+    const char *newline = options.minify ? "" : "\n";
+    if (options.vendor == AssetSource::Inline)
+    {
+        out.append(string(indent) + (css ? "<style>" : "<script>"));
+        out.appendStatic((*options.vendored)[index]);
+        out.append(string(css ? "</style>" : "</script>") + newline);
+        return;
+    }
+
+    string url = options.vendor == AssetSource::Local ? assetUrl(options, "vendor/") + asset.file : string(asset.url);
+    if (css)
+        out.append(string(indent) + "<link rel=\"stylesheet\" href=\"" + url + "\">" + newline);
+    else if (asset.feature == FeatureMath)
+        out.append(string(indent) + "<script id=\"MathJax-script\" async src=\"" + url + "\"></script>" + newline);
+    else
+        out.append(string(indent) + "<script src=\"" + url + "\"></script>" + newline);
+}
+
+// features is the converter's usedFeatures() for the page's document
+void appendHtmlFooter(OutputBuffer &out, const PageOptions &options = PageOptions(), unsigned features = 0)
+{
+    const PageTemplate &page = pageTemplate(options.minify);
+    out.appendStatic(page.contentEnd);
+    if (features & FeatureCode)
+    {
+        for (size_t i = 0; i < vendorAssetCount; i++)
+        {
+            if (vendorAssets[i].feature == FeatureCode)
+                appendVendorAsset(out, i, options);
+        }
+        out.appendStatic(page.highlightInit);
+    }
+    if (features & FeatureMath)
+    {
+        out.appendStatic(page.mathConfig);
+        for (size_t i = 0; i < vendorAssetCount; i++)
+        {
+            if (vendorAssets[i].feature == FeatureMath)
+                appendVendorAsset(out, i, options);
+        }
+    }
+    if (options.externalAssets)
+        out.append(string(options.minify ? "" : "  ") + "<script src=\"" + assetUrl(options, "md2html.js") + "\"></script>" +
+                   (options.minify ? "" : "\n"));
+    else
+    {
+        out.appendStatic(page.scriptOpen);
+        out.appendStatic(page.script);
+        out.appendStatic(page.scriptClose);
+    }
+    out.appendStatic(page.end);
+}
+
+// Page template up to and including the opening <body>
+string htmlHeader(const string &title = "Converted Document", const PageOptions &options = PageOptions())
+{
+    OutputBuffer out;
+    appendHtmlHeader(out, title, options);
+    return out.str();
+}
+
+// Page template after the converted content
+string htmlFooter(const PageOptions &options = PageOptions(), unsigned features = 0)
+{
+    OutputBuffer out;
+    appendHtmlFooter(out, options, features);
+    return out.str();
+}
+
+string generateHTML(const string &content, const string &title = "Converted Document", unsigned features = FeatureCode | FeatureMath)
+{
+    return htmlHeader(title) + content + htmlFooter(PageOptions(), features);
+}
+
+// ---------------------------------------------------------------------------
+// Conversion cache
+//
+// Finished pages are stored under a directory keyed by a hash of the input
+// bytes, the converter version and the page options, so an unchanged file
+// is copied (or reflinked) from the cache instead of converted. Entries are
+// written to a temporary name and renamed into place, so processes sharing
+// the directory only ever see complete pages. The modification time of an
+// entry is its last use; trim() drops the least recently used entries once
+// the cache outgrows its size cap.
+// ---------------------------------------------------------------------------
+
+// Bump when the generated HTML changes; cached pages are keyed on it.
+static const char converterVersion[] = "md2html 1.4";
+
+// 128-bit hash of data, two independent 64-bit lanes fed 16 bytes at a time.
+static void hashBytes(string_view data, uint64_t seed, uint64_t hash[2])
+{
+    const uint64_t prime1 = 0x9e3779b185ebca87ull;
+    const uint64_t prime2 = 0xc2b2ae3d27d4eb4full;
+    uint64_t a = seed ^ prime1;
+    uint64_t b = (seed + data.length()) ^ prime2;
+    auto mix = [](uint64_t h, uint64_t v, uint64_t prime)
+    {
+        h ^= v * prime;
+        h = (h << 31) | (h >> 33);
+        return h * 0x165667b19e3779f9ull;
+    };
+
+    const char *p = data.data();
+    size_t n = data.length();
+    for (; n >= 16; p += 16, n -= 16)
+    {
+        uint64_t v1, v2;
+        memcpy(&v1, p, 8);
+        memcpy(&v2, p + 8, 8);
+        a = mix(a, v1, prime2);
+        b = mix(b, v2, prime1);
+    }
+    uint64_t tail[2] = {0, 0};
+    memcpy(tail, p, n);
+    a = mix(a, tail[0] ^ n, prime2);
+    b = mix(b, tail[1], prime1);
+
+    // Final avalanche, each lane folding in the other
+    for (uint64_t *h : {&a, &b})
+    {
+        *h ^= *h >> 33;
+        *h *= prime2;
+        *h ^= *h >> 29;
+    }
+    hash[0] = a ^ (b >> 1);
+    hash[1] = b ^ (a << 1);
+}
+
+class ConversionCache
+{
+private:
+    fs::path root;
+    uintmax_t capacity;
+    atomic<size_t> hits{0};
+    atomic<size_t> misses{0};
+    atomic<size_t> stores{0};
+    atomic<size_t> evictions{0};
+    atomic<unsigned> tempCounter{0};
+
+    fs::path entryPath(const string &key) const
+    {
+        return root / key.substr(0, 2) / (key + ".html");
+    }
+
+    // Copies from to to, as a reflink where the filesystem supports it
+    static bool cloneFile(const fs::path &from, const fs::path &to)
+    {
+#if defined(MD2HTML_INOTIFY) && defined(FICLONE)
+        int source = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+        if (source >= 0)
+        {
+            int target = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            bool cloned = target >= 0 && ioctl(target, FICLONE, source) == 0;
+            if (target >= 0)
+                close(target);
+            close(source);
+            if (cloned)
+                return true;
+        }
+#endif
+        error_code ec;
+        fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+        return !ec;
+    }
+
+public:
+    ConversionCache(const string &directory, uintmax_t capacityBytes) : root(directory), capacity(capacityBytes)
+    {
+        error_code ec;
+        fs::create_directories(root, ec);
+    }
+
+    bool isOpen() const
+    {
+        error_code ec;
+        return fs::is_directory(root, ec);
+    }
+
+    // Key for a page converted from input with the given options
+    static string key(string_view input, string_view options)
+    {
+        uint64_t settings[2];
+        hashBytes(string(converterVersion) + '\0' + string(options), 0, settings);
+        uint64_t hash[2];
+        hashBytes(input, settings[0] ^ settings[1], hash);
+
+        static const char digits[] = "0123456789abcdef";
+        string hex(32, '0');
+        for (int i = 0; i < 32; i++)
+            hex[i] = digits[(hash[i / 16] >> (60 - 4 * (i % 16))) & 0xf];
+        return hex;
+    }
+
+    // Writes the cached page for key to output; false on a miss.
+    bool fetch(const string &key, const fs::path &output)
+    {
+        fs::path entry = entryPath(key);
+        error_code ec;
+        if (fs::exists(entry, ec) && cloneFile(entry, output))
+        {
+            // Mark as recently used; losing this race to an eviction is harmless
+            fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+            hits++;
+            return true;
+        }
+        misses++;
+        return false;
+    }
+
+    void store(const string &key, const OutputBuffer &page)
+    {
+        fs::path entry = entryPath(key);
+        error_code ec;
+        fs::create_directories(entry.parent_path(), ec);
+
+        // Unique per process and thread, then renamed over the entry at once
+#ifdef MD2HTML_POSIX
+        long pid = static_cast<long>(getpid());
+#else
+        long pid = 0;
+#endif
+        fs::path temp = entry;
+        temp += ".tmp." + to_string(pid) + "." + to_string(tempCounter++);
+        if (page.writeFile(temp.string()))
+        {
+            fs::rename(temp, entry, ec);
+            if (!ec)
+            {
+                stores++;
+                return;
+            }
+        }
+        fs::remove(temp, ec);
+    }
+
+    // Evicts least recently used entries until the cache is back under 90%
+    // of its cap. Only one process trims at a time; others skip it.
+    void trim()
+    {
+#ifdef MD2HTML_POSIX
+        int lock = open((root / "lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (lock < 0)
+            return;
+        if (flock(lock, LOCK_EX | LOCK_NB) != 0)
+        {
+            close(lock);
+            return;
+        }
+#endif
+        struct Entry
+        {
+            fs::path path;
+            fs::file_time_type used;
+            uintmax_t size;
+        };
+        vector<Entry> entries;
+        uintmax_t total = 0;
+        auto staleBefore = fs::file_time_type::clock::now() - chrono::hours(1);
+        error_code ec;
+        for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec))
+        {
+            error_code fileError;
+            if (!it->is_regular_file(fileError))
+                continue;
+            const fs::path &path = it->path();
+            fs::file_time_type used = it->last_write_time(fileError);
+            uintmax_t size = it->file_size(fileError);
+            if (fileError)
+                continue;
+            if (path.extension() == ".html")
+            {
+                entries.push_back({path, used, size});
+                total += size;
+            }
+            else if (path.string().find(".tmp.") != string::npos && used < staleBefore)
+                fs::remove(path, fileError); // Left behind by a process that died mid-write
+        }
+
+        if (total > capacity)
+        {
+            sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+                 { return a.used < b.used; });
+            uintmax_t target = capacity / 10 * 9;
+            for (const Entry &entry : entries)
+            {
+                if (total <= target)
+                    break;
+                if (fs::remove(entry.path, ec))
+                {
+                    total -= entry.size;
+                    evictions++;
+                }
+            }
+        }
+#ifdef MD2HTML_POSIX
+        flock(lock, LOCK_UN);
+        close(lock);
+#endif
+    }
+
+    // For one-file runs, which would otherwise walk the whole cache per
+    // file: trims only once the pages stored since the last trim could have
+    // taken it over its cap. A trim leaves a tenth of the cap free, so that
+    // is a tenth of the cap. The running total lives in the cache directory
+    // and is shared by every process using it; a new cache trims at once.
+    void trimIfDue(uintmax_t storedBytes)
+    {
+#ifdef MD2HTML_POSIX
+        int counter = open((root / "stored").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (counter < 0)
+            return;
+        if (flock(counter, LOCK_EX) != 0)
+        {
+            close(counter);
+            return;
+        }
+        char text[32] = {};
+        ssize_t got = pread(counter, text, sizeof(text) - 1, 0);
+        uintmax_t stored = (got > 0 ? strtoull(text, nullptr, 10) : 0) + storedBytes;
+        bool due = got <= 0 || stored >= capacity / 10;
+        string updated = to_string(due ? 0 : stored);
+        if (pwrite(counter, updated.data(), updated.length(), 0) == static_cast<ssize_t>(updated.length()))
+        {
+            int ignored = ftruncate(counter, static_cast<off_t>(updated.length()));
+            (void)ignored;
+        }
+        flock(counter, LOCK_UN);
+        close(counter);
+        if (due)
+            trim();
+#else
+        (void)storedBytes;
+        trim();
+#endif
+    }
+
+    size_t hitCount() const { return hits; }
+    size_t missCount() const { return misses; }
+    size_t storeCount() const { return stores; }
+    size_t evictionCount() const { return evictions; }
+
+    void printStats(ostream &out) const
+    {
+        size_t lookups = hits + misses;
+        out << "  Cache:  " << hits << " hits, " << misses << " misses";
+        if (lookups > 0)
+            out << " (" << fixed << setprecision(1) << 100.0 * hits / lookups << "% hit rate)";
+        if (evictions > 0)
+            out << ", " << evictions << " evicted";
+        out << "\n";
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Batch conversion
+//
+// Converts a directory tree (or a manifest listing files) on a pool of
+// worker threads. Every worker has its own queue and its own converter;
+// a worker that runs dry steals from the others, so one huge file only
+// ever occupies a single thread.
+// ---------------------------------------------------------------------------
+
+struct BatchJob
+{
+    fs::path input;
+    fs::path output;
+    uintmax_t size;
+    SearchIndex *index = nullptr; // The file's own index, with --search-index
+};
+
+// Jobs of one worker. The owner takes from the front, where the largest
+// files are; thieves take from the back.
+class WorkQueue
+{
+private:
+    mutex lock;
+    deque<BatchJob> jobs;
+
+public:
+    void push(BatchJob job)
+    {
+        lock_guard<mutex> guard(lock);
+        jobs.push_back(move(job));
+    }
+
+    bool pop(BatchJob &job)
+    {
+        lock_guard<mutex> guard(lock);
+        if (jobs.empty())
+            return false;
+        job = move(jobs.front());
+        jobs.pop_front();
+        return true;
+    }
+
+    bool steal(BatchJob &job)
+    {
+        lock_guard<mutex> guard(lock);
+        if (jobs.empty())
+            return false;
+        job = move(jobs.back());
+        jobs.pop_back();
+        return true;
+    }
+};
+
+struct BatchStats
+{
+    atomic<size_t> converted{0};
+    atomic<size_t> failed{0};
+    atomic<uintmax_t> bytes{0};
+    mutex logLock;
+};
+
+static bool isMarkdownFile(const fs::path &path)
+{
+    string extension = path.extension().string();
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".md" || extension == ".markdown";
+}
+
+static fs::path batchOutputPath(const fs::path &outputDir, const fs::path &relative)
+{
+    fs::path output = outputDir / relative;
+    output.replace_extension(".html");
+    return output;
+}
+
+// URL of page in a search index written to indexPath
+static string searchIndexUrl(const fs::path &page, const fs::path &indexPath)
+{
+    fs::path indexDir = indexPath.parent_path().empty() ? fs::path(".") : indexPath.parent_path();
+    return fs::absolute(page).lexically_normal().lexically_relative(fs::absolute(indexDir).lexically_normal()).generic_string();
+}
+
+// Fills jobs from source, which is either a directory searched for
+// markdown files or a manifest with one path per line. Output paths mirror
+// the input paths below outputDir.
+bool collectBatchJobs(const string &source, const string &outputDir, vector<BatchJob> &jobs)
+{
+    error_code ec;
+    fs::path sourcePath(source);
+    if (fs::is_directory(sourcePath, ec))
+    {
+        for (fs::recursive_directory_iterator it(sourcePath, ec), end; !ec && it != end; it.increment(ec))
+        {
+            if (!it->is_regular_file(ec) || !isMarkdownFile(it->path()))
+                continue;
+            uintmax_t size = it->file_size(ec);
+            jobs.push_back({it->path(), batchOutputPath(outputDir, it->path().lexically_relative(sourcePath)), ec ? 0 : size});
+        }
+        if (ec)
+        {
+            cerr << "Error: Cannot read directory '" << source << "': " << ec.message() << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    ifstream manifest(source);
+    if (!manifest.is_open())
+    {
+        cerr << "Error: Batch source '" << source << "' is neither a directory nor a readable manifest.\n";
+        return false;
+    }
+
+    // Relative entries are resolved against the manifest's directory
+    fs::path base = sourcePath.parent_path();
+    string line;
+    while (getline(manifest, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+        fs::path entry(line);
+        fs::path input = entry.is_absolute() ? entry : base / entry;
+        fs::path relative = entry.lexically_normal();
+        if (entry.is_absolute())
+            relative = relative.relative_path();
+        // Absolute entries are re-rooted under outputDir; a relative one
+        // that climbs out of it is refused
+        if (!relative.empty() && *relative.begin() == "..")
+        {
+            cerr << "Error: Manifest entry '" << line << "' leads outside the output directory.\n";
+            return false;
+        }
+        uintmax_t size = fs::file_size(input, ec);
+        jobs.push_back({input, batchOutputPath(outputDir, relative), ec ? 0 : size});
+    }
+    return true;
+}
+
+static void convertBatchFile(const MarkdownConverter &converter, const BatchJob &job, BatchStats &stats,
+                             const PageOptions &pageOptions, ConversionCache *cache = nullptr,
+                             const string &cacheOptions = string())
+{
+    string error;
+    try
+    {
+        MappedFile input(job.input.string());
+        if (!input.isOpen())
+            error = "cannot open input";
+        else
+        {
+            error_code ec;
+            fs::create_directories(job.output.parent_path(), ec);
+
+            // Pages in subdirectories link the shared assets relative to themselves
+            PageOptions options = pageOptions;
+            if (options.externalAssets || options.vendor == AssetSource::Local)
+                options.assetPath = assetPathFor(options.assetDirectory, job.output.parent_path());
+
+            string key = cache != nullptr ? ConversionCache::key(input.view(), cacheOptions + ";assets=" + options.assetPath)
+                                          : string();
+            if (cache != nullptr && cache->fetch(key, job.output))
+            {
+                if (job.index != nullptr)
+                    converter.indexDocument(input.view(), *job.index);
+                stats.converted++;
+                stats.bytes += input.view().length();
+                return;
+            }
+
+            OutputBuffer page;
+            appendHtmlHeader(page, "Markdown Document", options);
+            unsigned features = 0;
+            converter.convertToHTML(input.view(), page, &features, job.index);
+            appendHtmlFooter(page, options, features);
+            if (page.writeFile(job.output.string()))
+            {
+                if (cache != nullptr)
+                    cache->store(key, page);
+                stats.converted++;
+                stats.bytes += input.view().length();
+                return;
+            }
+            error = "cannot write '" + job.output.string() + "'";
+        }
+    }
+    catch (const exception &e)
+    {
+        error = e.what();
+    }
+
+    if (job.index != nullptr)
+        *job.index = SearchIndex();
+    stats.failed++;
+    lock_guard<mutex> guard(stats.logLock);
+    cerr << "Error: " << job.input.string() << ": " << error << "\n";
+}
+
+static void batchWorker(size_t self, vector<unique_ptr<WorkQueue>> &queues, BatchStats &stats,
+                        const MarkdownConverter &converter, const PageOptions &pageOptions, ConversionCache *cache,
+                        const string &cacheOptions)
+{
+    BatchJob job;
+    while (true)
+    {
+        bool found = queues[self]->pop(job);
+        for (size_t k = 1; !found && k < queues.size(); k++)
+            found = queues[(self + k) % queues.size()]->steal(job);
+
+        // No jobs are added once workers start, so empty queues mean done
+        if (!found)
+            return;
+        convertBatchFile(converter, job, stats, pageOptions, cache, cacheOptions);
+    }
+}
+
+int runBatch(const string &source, const string &outputDir, unsigned threads, const ConverterLimits &limits = ConverterLimits(),
+             const PageOptions &pageOptions = PageOptions(), ConversionCache *cache = nullptr,
+             const string &cacheOptions = string(), const string &indexPath = string())
+{
+    vector<BatchJob> jobs;
+    if (!collectBatchJobs(source, outputDir, jobs))
+        return 1;
+    if (!writePageAssets(pageOptions))
+        return 1;
+
+    // Every file is indexed on its own by whichever worker converts it; the
+    // indexes are merged in output path order once all are done
+    vector<SearchIndex> indexes(indexPath.empty() ? 0 : jobs.size());
+    if (!indexPath.empty())
+    {
+        sort(jobs.begin(), jobs.end(), [](const BatchJob &a, const BatchJob &b)
+             { return a.output < b.output; });
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            indexes[i].beginDocument(searchIndexUrl(jobs[i].output, indexPath));
+            jobs[i].index = &indexes[i];
+        }
+    }
+
+    if (threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    threads = static_cast<unsigned>(min<size_t>(threads, max<size_t>(jobs.size(), 1)));
+
+    // Largest files first, dealt round-robin so every worker starts with
+    // a share of the big ones
+    sort(jobs.begin(), jobs.end(), [](const BatchJob &a, const BatchJob &b)
+         { return a.size > b.size; });
+    vector<unique_ptr<WorkQueue>> queues;
+    for (unsigned i = 0; i < threads; i++)
+        queues.push_back(make_unique<WorkQueue>());
+    for (size_t i = 0; i < jobs.size(); i++)
+        queues[i % threads]->push(move(jobs[i]));
+
+    // One converter for every worker; each parses in a context of its own
+    MarkdownConverter converter;
+    converter.setLimits(limits);
+    BatchStats stats;
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back(batchWorker, i, ref(queues), ref(stats), cref(converter), cref(pageOptions), cache,
+                             cref(cacheOptions));
+    for (thread &worker : workers)
+        worker.join();
+
+    SearchIndex index;
+    for (SearchIndex &fileIndex : indexes)
+        index.merge(move(fileIndex));
+    bool indexWritten = indexPath.empty() || index.write(indexPath);
+    if (!indexWritten)
+        cerr << "Error: Cannot write search index '" << indexPath << "'.\n";
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double megabytes = static_cast<double>(stats.bytes) / (1024.0 * 1024.0);
+    cout << "Batch conversion complete!\n";
+    cout << "  Files:  " << stats.converted << " converted";
+    if (stats.failed > 0)
+        cout << ", " << stats.failed << " failed";
+    cout << " (" << threads << " threads)\n";
+    cout << fixed << setprecision(2);
+    cout << "  Time:   " << seconds << " s\n";
+    cout << "  Speed:  " << (seconds > 0 ? stats.converted / seconds : 0.0) << " files/s, "
+         << (seconds > 0 ? megabytes / seconds : 0.0) << " MB/s\n";
+    if (cache != nullptr)
+    {
+        cache->printStats(cout);
+        if (cache->storeCount() > 0)
+            cache->trim();
+    }
+    if (!indexPath.empty() && indexWritten)
+        cout << "  Index:  " << indexPath << " (" << index.documentCount() << " pages, " << index.sectionCount()
+             << " sections, " << index.termCount() << " terms)\n";
+    cout << "  Output: " << outputDir << "\n";
+
+    return stats.failed > 0 || !indexWritten ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Watch mode
+//
+// Converts every file under a directory once, then waits on inotify and
+// converts files again as they are saved. A burst of events (editors often
+// write, truncate and rename in one save) is coalesced by waiting until the
+// directory has been quiet for the debounce interval. The converter stays
+// warm between saves.
+// ---------------------------------------------------------------------------
+
+#ifdef MD2HTML_INOTIFY
+class DirectoryWatcher
+{
+private:
+    int fd = -1;
+    map<int, fs::path> watches;
+
+public:
+    DirectoryWatcher() : fd(inotify_init1(IN_CLOEXEC)) {}
+
+    ~DirectoryWatcher()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    DirectoryWatcher(const DirectoryWatcher &) = delete;
+    DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+
+    // Watches dir and every directory below it
+    void addTree(const fs::path &dir)
+    {
+        addDirectory(dir);
+        error_code ec;
+        for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+        {
+            if (it->is_directory(ec))
+                addDirectory(it->path());
+        }
+    }
+
+    void addDirectory(const fs::path &dir)
+    {
+        int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+        if (wd >= 0)
+            watches[wd] = dir;
+    }
+
+    // Waits up to timeoutMs (forever when negative) for events. Saved
+    // markdown files are added to changed; new directories are watched and
+    // the markdown files already in them added too. Returns false on error.
+    bool wait(int timeoutMs, vector<fs::path> &changed)
+    {
+        pollfd ready{fd, POLLIN, 0};
+        int count = poll(&ready, 1, timeoutMs);
+        if (count < 0)
+            return errno == EINTR;
+        if (count == 0)
+            return true;
+
+        alignas(inotify_event) char buffer[64 * 1024];
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length < 0)
+            return errno == EINTR || errno == EAGAIN;
+
+        for (char *p = buffer; p < buffer + length;)
+        {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_IGNORED)
+            {
+                watches.erase(event->wd);
+                continue;
+            }
+            auto watch = watches.find(event->wd);
+            if (watch == watches.end() || event->len == 0)
+                continue;
+
+            fs::path path = watch->second / event->name;
+            if (event->mask & IN_ISDIR)
+            {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    addTree(path);
+                    error_code ec;
+                    for (fs::recursive_directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec))
+                    {
+                        if (it->is_regular_file(ec) && isMarkdownFile(it->path()))
+                            changed.push_back(it->path());
+                    }
+                }
+            }
+            else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && isMarkdownFile(path))
+                changed.push_back(path);
+        }
+        return true;
+    }
+};
+#endif
+
+int runWatch(const string &watchDir, const string &outputDir, int debounceMs, const ConverterLimits &limits = ConverterLimits(),
+             const PageOptions &pageOptions = PageOptions())
+{
+#ifndef MD2HTML_INOTIFY
+    (void)outputDir;
+    (void)debounceMs;
+    (void)limits;
+    (void)pageOptions;
+    cerr << "Error: --watch needs inotify, which is not available on this platform ('" << watchDir << "').\n";
+    return 1;
+#else
+    using clock = chrono::steady_clock;
+    error_code ec;
+    if (!fs::is_directory(watchDir, ec))
+    {
+        cerr << "Error: '" << watchDir << "' is not a directory.\n";
+        return 1;
+    }
+
+    DirectoryWatcher watcher;
+    if (!watcher.isOpen())
+    {
+        cerr << "Error: Cannot initialize inotify: " << strerror(errno) << "\n";
+        return 1;
+    }
+    watcher.addTree(watchDir);
+    if (!writePageAssets(pageOptions))
+        return 1;
+
+    // Bring every output up to date first
+    MarkdownConverter converter;
+    converter.setLimits(limits);
+    BatchStats stats;
+    vector<BatchJob> jobs;
+    collectBatchJobs(watchDir, outputDir, jobs);
+    for (const BatchJob &job : jobs)
+        convertBatchFile(converter, job, stats, pageOptions);
+    cout << "Watching " << watchDir << " (" << stats.converted << " files converted), press Ctrl+C to stop\n";
+
+    // Saved files with the time their first event arrived
+    map<fs::path, clock::time_point> pending;
+    const auto maxDelay = chrono::milliseconds(20 * debounceMs);
+    vector<fs::path> changed;
+    while (true)
+    {
+        changed.clear();
+        if (!watcher.wait(pending.empty() ? -1 : debounceMs, changed))
+        {
+            cerr << "Error: Watching '" << watchDir << "' failed: " << strerror(errno) << "\n";
+            return 1;
+        }
+        auto now = clock::now();
+        for (const fs::path &path : changed)
+            pending.emplace(path, now);
+
+        // Convert once the burst is over, or when saves never stop coming
+        bool quiet = changed.empty();
+        bool overdue = !pending.empty() && now - min_element(pending.begin(), pending.end(), [](const auto &a, const auto &b)
+                                                             { return a.second < b.second; })->second >= maxDelay;
+        if (pending.empty() || (!quiet && !overdue))
+            continue;
+
+        for (const auto &file : pending)
+        {
+            BatchJob job{file.first, batchOutputPath(outputDir, file.first.lexically_relative(watchDir)), 0};
+            size_t failed = stats.failed;
+            convertBatchFile(converter, job, stats, pageOptions);
+            if (stats.failed == failed)
+            {
+                double ms = chrono::duration<double, milli>(clock::now() - file.second).count();
+                cout << "Updated " << job.output.string() << " (" << fixed << setprecision(1) << ms << " ms after save)\n"
+                     << flush;
+            }
+        }
+        pending.clear();
+    }
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Server mode
+//
+// Listens on a Unix socket and converts markdown sent over it, so a caller
+// pays for starting the process once rather than per document. Requests
+// and replies are framed the same way:
+//
+//   request: kind (1 byte) | length (4 bytes, big-endian) | markdown
+//   reply:   status (1 byte) | length (4 bytes, big-endian) | body
+//
+// kind is 'F' for an HTML fragment (TOC, body and footnotes), 'P' for a
+// whole page and 'S' for the server's counters as JSON. status is 'O', or
+// 'E' with an error message as the body. A connection may send any number
+// of requests, waiting for each reply before the next request.
+//
+// One thread polls the listening socket and every connection, and does all
+// of their reading and writing without blocking. A request is queued for
+// the worker pool once its frame is complete; a worker renders the reply
+// with its own converter and hands it back, and the polling thread writes
+// it out. So a slow client never holds a worker: one that stops mid-frame
+// for serveTimeoutSeconds, or takes longer than that to take a reply, is
+// dropped.
+// ---------------------------------------------------------------------------
+
+#ifdef MD2HTML_POSIX
+static const uint32_t maxServeRequest = 64 << 20;
+static const int serveTimeoutSeconds = 10; // For a stalled request, and for writing a whole reply
+static const size_t serveHeaderSize = 5;
+
+struct ServeCounters
+{
+    static const size_t latencyBuckets = 24; // Up to 1 µs, 2 µs, ... 2^22 µs, then slower
+
+    atomic<size_t> connections{0};
+    atomic<size_t> requests{0};
+    atomic<size_t> errors{0};
+    atomic<uintmax_t> bytesIn{0};
+    atomic<uintmax_t> bytesOut{0};
+    atomic<size_t> queueDepth{0};
+    atomic<size_t> maxQueueDepth{0};
+    atomic<size_t> latency[latencyBuckets]{};
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+
+    void recordLatency(chrono::steady_clock::duration elapsed)
+    {
+        auto microseconds = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+        size_t bucket = 0;
+        while (bucket + 1 < latencyBuckets && (int64_t(1) << bucket) < microseconds)
+            bucket++;
+        latency[bucket]++;
+    }
+
+    string json(size_t workers) const
+    {
+        ostringstream out;
+        out << "{\"uptime_s\": " << fixed << setprecision(3)
+            << chrono::duration<double>(chrono::steady_clock::now() - started).count()
+            << ", \"workers\": " << workers << ", \"connections\": " << connections << ", \"requests\": " << requests
+            << ", \"errors\": " << errors << ", \"bytes_in\": " << bytesIn << ", \"bytes_out\": " << bytesOut
+            << ", \"queue_depth\": " << queueDepth << ", \"max_queue_depth\": " << maxQueueDepth
+            << ", \"latency_us\": {";
+        for (size_t i = 0; i < latencyBuckets; i++)
+        {
+            out << (i > 0 ? ", \"" : "\"");
+            if (i + 1 < latencyBuckets)
+                out << (int64_t(1) << i);
+            else
+                out << "inf";
+            out << "\": " << latency[i];
+        }
+        out << "}}";
+        return out.str();
+    }
+};
+
+// A connection whose request has been read in full, and when it was
+struct ServeJob
+{
+    int fd;
+    char kind;
+    uint32_t length;
+    string markdown; // Left empty when length is over maxServeRequest
+    chrono::steady_clock::time_point queued;
+};
+
+// A rendered reply, header included, on its way back to be written
+struct ServeReply
+{
+    int fd;
+    OutputBuffer frame;
+    bool keep; // Whether the connection takes another request afterwards
+    chrono::steady_clock::time_point queued;
+};
+
+// A connection the polling thread is reading a request from, or writing a
+// reply to
+struct ServeConnection
+{
+    explicit ServeConnection(int connectionFd) : fd(connectionFd) {}
+
+    int fd;
+    unsigned char header[serveHeaderSize] = {};
+    size_t got = 0; // Bytes of the frame read so far
+    uint32_t length = 0;
+    string markdown;
+    chrono::steady_clock::time_point lastRead;
+
+    bool replying = false;
+    OutputBuffer reply;
+    OutputBuffer::Cursor written;
+    bool keep = true;
+    chrono::steady_clock::time_point queued;
+    chrono::steady_clock::time_point deadline; // For the whole reply
+
+    void startReply(ServeReply &&rendered, chrono::steady_clock::time_point now)
+    {
+        replying = true;
+        reply = move(rendered.frame);
+        written = OutputBuffer::Cursor();
+        keep = rendered.keep;
+        queued = rendered.queued;
+        deadline = now + chrono::seconds(serveTimeoutSeconds);
+    }
+
+    void awaitRequest()
+    {
+        replying = false;
+        reply = OutputBuffer();
+        got = 0;
+        length = 0;
+        markdown.clear();
+    }
+};
+
+// Connections on their way to the workers, and back to the polling thread,
+// which is woken through wakeFd when one comes back
+class ServeQueue
+{
+private:
+    mutex lock;
+    condition_variable ready;
+    deque<ServeJob> jobs;
+    vector<ServeReply> returned;
+    bool closed = false;
+    ServeCounters &counters;
+    int wakeFd;
+
+public:
+    ServeQueue(ServeCounters &serveCounters, int wakeWriteFd) : counters(serveCounters), wakeFd(wakeWriteFd) {}
+
+    void push(ServeJob &&job)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            jobs.push_back(move(job));
+            size_t depth = ++counters.queueDepth;
+            if (depth > counters.maxQueueDepth)
+                counters.maxQueueDepth = depth;
+        }
+        ready.notify_one();
+    }
+
+    // Waits for a job; false once the queue is closed and drained
+    bool pop(ServeJob &job)
+    {
+        unique_lock<mutex> guard(lock);
+        ready.wait(guard, [this]
+                   { return closed || !jobs.empty(); });
+        if (jobs.empty())
+            return false;
+        job = move(jobs.front());
+        jobs.pop_front();
+        counters.queueDepth--;
+        return true;
+    }
+
+    void handBack(ServeReply &&reply)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            returned.push_back(move(reply));
+        }
+        ssize_t ignored = write(wakeFd, "r", 1);
+        (void)ignored;
+    }
+
+    void takeReturned(vector<ServeReply> &replies)
+    {
+        lock_guard<mutex> guard(lock);
+        for (ServeReply &reply : returned)
+            replies.push_back(move(reply));
+        returned.clear();
+    }
+
+    void close()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            closed = true;
+        }
+        ready.notify_all();
+    }
+};
+
+static volatile sig_atomic_t serveStopping = 0;
+static int serveWakeFd = -1;
+
+static void stopServing(int)
+{
+    serveStopping = 1;
+    ssize_t ignored = write(serveWakeFd, "s", 1);
+    (void)ignored;
+}
+
+enum class FrameProgress
+{
+    Partial,
+    Complete,
+    Closed
+};
+
+// Reads what has arrived of connection's request without blocking, and
+// nothing past its end. An oversized request is complete once its header is.
+static FrameProgress readFrame(ServeConnection &connection, chrono::steady_clock::time_point now)
+{
+    const size_t headerSize = sizeof(connection.header);
+    while (true)
+    {
+        char *target;
+        size_t wanted;
+        if (connection.got < headerSize)
+        {
+            target = reinterpret_cast<char *>(connection.header) + connection.got;
+            wanted = headerSize - connection.got;
+        }
+        else
+        {
+            size_t bodyRead = connection.got - headerSize;
+            if (connection.length > maxServeRequest || bodyRead == connection.markdown.length())
+                return FrameProgress::Complete;
+            target = &connection.markdown[bodyRead];
+            wanted = connection.markdown.length() - bodyRead;
+        }
+
+        ssize_t got = recv(connection.fd, target, wanted, MSG_DONTWAIT);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return FrameProgress::Partial;
+        if (got <= 0)
+            return FrameProgress::Closed;
+        connection.got += static_cast<size_t>(got);
+        connection.lastRead = now;
+        if (connection.got == headerSize)
+        {
+            const unsigned char *h = connection.header;
+            connection.length = uint32_t(h[1]) << 24 | uint32_t(h[2]) << 16 | uint32_t(h[3]) << 8 | h[4];
+            if (connection.length <= maxServeRequest)
+                connection.markdown.resize(connection.length);
+        }
+    }
+}
+
+// Writes what the socket takes of connection's reply without blocking
+static FrameProgress writeReply(ServeConnection &connection, ServeCounters &counters,
+                                chrono::steady_clock::time_point now)
+{
+    const OutputBuffer &reply = connection.reply;
+    if (!reply.write(connection.fd, connection.written))
+        return FrameProgress::Closed;
+    if (!reply.finished(connection.written))
+        return FrameProgress::Partial;
+    counters.bytesOut += reply.length() - serveHeaderSize;
+    counters.recordLatency(now - connection.queued);
+    return FrameProgress::Complete;
+}
+
+// Renders the reply to the request read for job. It is the connection's
+// last when the frame cannot be trusted.
+static ServeReply serveRequest(const MarkdownConverter &converter, const ServeJob &job, const PageOptions &pageOptions,
+                               ServeCounters &counters, size_t workers)
+{
+    const string &markdown = job.markdown;
+    counters.requests++;
+
+    OutputBuffer body;
+    char status = 'O';
+    bool keep = true;
+    if (job.length > maxServeRequest)
+    {
+        status = 'E';
+        body.append(string("request larger than ") + to_string(maxServeRequest) + " bytes");
+        keep = false;
+    }
+    else
+    {
+        counters.bytesIn += job.length;
+        try
+        {
+            switch (job.kind)
+            {
+            case 'F':
+                converter.convertToHTML(markdown, body);
+                break;
+            case 'P':
+            {
+                unsigned features = 0;
+                appendHtmlHeader(body, "Markdown Document", pageOptions);
+                converter.convertToHTML(markdown, body, &features);
+                appendHtmlFooter(body, pageOptions, features);
+                break;
+            }
+            case 'S':
+                body.append(counters.json(workers));
+                break;
+            default:
+                status = 'E';
+                body.append(string("unknown request kind"));
+                break;
+            }
+        }
+        catch (const exception &e)
+        {
+            body = OutputBuffer();
+            status = 'E';
+            body.append(string("conversion failed: ") + e.what());
+        }
+    }
+
+    if (status != 'O')
+        counters.errors++;
+    size_t replyLength = body.length();
+    char header[serveHeaderSize] = {status, static_cast<char>(replyLength >> 24), static_cast<char>(replyLength >> 16),
+                                    static_cast<char>(replyLength >> 8), static_cast<char>(replyLength)};
+    body.prepend(string(header, sizeof(header)));
+    return {job.fd, move(body), keep, job.queued};
+}
+
+static void serveWorker(ServeQueue &queue, ServeCounters &counters, const MarkdownConverter &converter,
+                        const PageOptions &pageOptions, size_t workers)
+{
+    ServeJob job;
+    while (queue.pop(job))
+    {
+        queue.handBack(serveRequest(converter, job, pageOptions, counters, workers));
+    }
+}
+#endif
+
+int runServe(const string &socketPath, unsigned threads, const ConverterLimits &limits = ConverterLimits(),
+             const PageOptions &pageOptions = PageOptions())
+{
+#ifndef MD2HTML_POSIX
+    (void)threads;
+    (void)limits;
+    (void)pageOptions;
+    cerr << "Error: --serve needs Unix sockets, which are not available on this platform ('" << socketPath << "').\n";
+    return 1;
+#else
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.length() >= sizeof(address.sun_path))
+    {
+        cerr << "Error: Socket path '" << socketPath << "' is too long.\n";
+        return 1;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.length() + 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        cerr << "Error: Cannot create socket: " << strerror(errno) << "\n";
+        return 1;
+    }
+    fcntl(listener, F_SETFD, FD_CLOEXEC);
+
+    // A socket file nobody answers on is left over from an earlier run
+    if (connect(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0)
+    {
+        cerr << "Error: Another server is already listening on '" << socketPath << "'.\n";
+        close(listener);
+        return 1;
+    }
+    close(listener);
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        cerr << "Error: Cannot create socket: " << strerror(errno) << "\n";
+        return 1;
+    }
+    fcntl(listener, F_SETFD, FD_CLOEXEC);
+    unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+    {
+        cerr << "Error: Cannot listen on '" << socketPath << "': " << strerror(errno) << "\n";
+        close(listener);
+        return 1;
+    }
+
+    int wake[2];
+    if (pipe(wake) != 0)
+    {
+        cerr << "Error: Cannot create pipe: " << strerror(errno) << "\n";
+        close(listener);
+        unlink(socketPath.c_str());
+        return 1;
+    }
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+    serveWakeFd = wake[1];
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stopServing);
+    signal(SIGTERM, stopServing);
+
+    if (threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    MarkdownConverter converter;
+    converter.setLimits(limits);
+    ServeCounters counters;
+    ServeQueue queue(counters, wake[1]);
+    vector<thread> workers;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back(serveWorker, ref(queue), ref(counters), cref(converter), cref(pageOptions), size_t(threads));
+    cout << "Serving on " << socketPath << " with " << threads << " workers, press Ctrl+C to stop\n" << flush;
+
+    vector<ServeConnection> connections, kept;
+    vector<ServeReply> returned;
+    vector<pollfd> polled;
+
+    // Where a connection goes after reading or writing: on to the workers,
+    // back to be polled, or closed
+    auto settle = [&](ServeConnection &connection, FrameProgress progress, chrono::steady_clock::time_point now)
+    {
+        if (connection.replying)
+        {
+            if (progress == FrameProgress::Complete && connection.keep)
+            {
+                connection.awaitRequest();
+                kept.push_back(move(connection));
+            }
+            else if (progress == FrameProgress::Partial && now < connection.deadline)
+                kept.push_back(move(connection));
+            else
+                close(connection.fd);
+        }
+        else if (progress == FrameProgress::Complete)
+            queue.push({connection.fd, char(connection.header[0]), connection.length, move(connection.markdown), now});
+        else if (progress == FrameProgress::Closed ||
+                 (connection.got > 0 && now - connection.lastRead > chrono::seconds(serveTimeoutSeconds)))
+            close(connection.fd);
+        else
+            kept.push_back(move(connection));
+    };
+
+    // Replies from the workers are written at once, as far as the socket takes them
+    auto takeReplies = [&](chrono::steady_clock::time_point now)
+    {
+        returned.clear();
+        queue.takeReturned(returned);
+        for (ServeReply &reply : returned)
+        {
+            ServeConnection connection(reply.fd);
+            connection.startReply(move(reply), now);
+            settle(connection, writeReply(connection, counters, now), now);
+        }
+    };
+
+    // Polls every connection, plus the listener and wake pipe when given,
+    // and moves each one on. Connections with a deadline running make the
+    // poll wake up now and then to check it.
+    auto pollConnections = [&](int listenFd, int wakeFd) -> bool
+    {
+        polled.clear();
+        polled.push_back({listenFd, POLLIN, 0});
+        polled.push_back({wakeFd, POLLIN, 0});
+        bool timed = false;
+        for (const ServeConnection &connection : connections)
+        {
+            polled.push_back({connection.fd, short(connection.replying ? POLLOUT : POLLIN), 0});
+            timed = timed || connection.replying || connection.got > 0;
+        }
+        if (poll(polled.data(), polled.size(), timed ? 1000 : -1) < 0)
+            return errno == EINTR;
+
+        auto now = chrono::steady_clock::now();
+        kept.clear();
+        for (size_t i = 2; i < polled.size(); i++)
+        {
+            ServeConnection &connection = connections[i - 2];
+            FrameProgress progress = FrameProgress::Partial;
+            if (polled[i].revents != 0)
+                progress = connection.replying ? writeReply(connection, counters, now) : readFrame(connection, now);
+            settle(connection, progress, now);
+        }
+        if (polled[1].revents != 0)
+        {
+            char drained[64];
+            while (read(wakeFd, drained, sizeof(drained)) > 0)
+                ;
+            takeReplies(now);
+        }
+        swap(connections, kept);
+        return true;
+    };
+
+    int status = 0;
+    while (!serveStopping)
+    {
+        if (!pollConnections(listener, wake[0]))
+        {
+            cerr << "Error: Serving '" << socketPath << "' failed: " << strerror(errno) << "\n";
+            status = 1;
+            break;
+        }
+        if (polled[0].revents != 0)
+        {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                connections.emplace_back(fd);
+                counters.connections++;
+            }
+        }
+    }
+
+    // Requests already queued are still answered. Replies still going out
+    // get until their deadline; connections waiting for a request are closed.
+    queue.close();
+    for (thread &worker : workers)
+        worker.join();
+    kept.clear();
+    takeReplies(chrono::steady_clock::now());
+    for (ServeConnection &connection : connections)
+        kept.push_back(move(connection));
+    swap(connections, kept);
+    while (true)
+    {
+        kept.clear();
+        for (ServeConnection &connection : connections)
+        {
+            if (connection.replying)
+                kept.push_back(move(connection));
+            else
+                close(connection.fd);
+        }
+        swap(connections, kept);
+        if (connections.empty() || !pollConnections(-1, -1))
+            break;
+    }
+    for (const ServeConnection &connection : connections)
+        close(connection.fd);
+    close(listener);
+    unlink(socketPath.c_str());
+    serveWakeFd = -1;
+    close(wake[0]);
+    close(wake[1]);
+    cout << "Server stopped: " << counters.json(threads) << "\n";
+    return status;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Library API (md2html.h)
+//
+// A converter only holds settings, so each call makes one; the parsing
+// state it uses is the calling thread's, kept from one call to the next.
+// Exceptions stop here and come back as status codes.
+// ---------------------------------------------------------------------------
+
+extern "C" MD2HTML_API void md2html_options_init(md2html_options *options)
+{
+    if (options == nullptr)
+        return;
+    ConverterLimits limits;
+    *options = md2html_options();
+    options->max_line_length = limits.maxLineLength;
+    options->max_nesting = static_cast<size_t>(limits.maxNesting);
+    options->max_table_columns = limits.maxTableColumns;
+    options->max_footnotes = limits.maxFootnotes;
+}
+
+// Converts into out, page template included unless options ask for a fragment
+static md2html_status renderLibraryPage(const char *markdown, size_t length, const md2html_options *options,
+                                        OutputBuffer &out)
+{
+    if (markdown == nullptr && length > 0)
+        return MD2HTML_INVALID_ARGUMENT;
+    md2html_options defaults;
+    if (options == nullptr)
+    {
+        md2html_options_init(&defaults);
+        options = &defaults;
+    }
+
+    try
+    {
+        ConverterLimits limits;
+        if (options->max_line_length != 0)
+            limits.maxLineLength = options->max_line_length;
+        if (options->max_nesting != 0)
+            limits.maxNesting = static_cast<int>(min<size_t>(options->max_nesting, INT_MAX));
+        if (options->max_table_columns != 0)
+            limits.maxTableColumns = options->max_table_columns;
+        if (options->max_footnotes != 0)
+            limits.maxFootnotes = options->max_footnotes;
+        PageOptions page;
+        page.externalAssets = options->external_css != 0;
+        page.minify = options->minify != 0;
+        page.assetPath = options->asset_path != nullptr ? options->asset_path : "";
+
+        MarkdownConverter converter;
+        converter.setLimits(limits);
+        unsigned features = 0;
+        if (!options->fragment)
+            appendHtmlHeader(out, options->title != nullptr ? options->title : "Markdown Document", page);
+        converter.convertToHTML(string_view(markdown, length), out, &features);
+        if (!options->fragment)
+            appendHtmlFooter(out, page, features);
+    }
+    catch (const bad_alloc &)
+    {
+        return MD2HTML_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        return MD2HTML_INTERNAL_ERROR;
+    }
+    return MD2HTML_OK;
+}
+
+extern "C" MD2HTML_API md2html_status md2html_render(const char *markdown, size_t length, md2html_sink *sink,
+                                                     const md2html_options *options)
+{
+    if (sink == nullptr || sink->write == nullptr)
+        return MD2HTML_INVALID_ARGUMENT;
+    OutputBuffer out;
+    md2html_status status = renderLibraryPage(markdown, length, options, out);
+    if (status != MD2HTML_OK)
+        return status;
+    try
+    {
+        bool written = out.forEach([sink](string_view segment)
+                                   { return sink->write(sink->user, segment.data(), segment.length()) == 0; });
+        return written ? MD2HTML_OK : MD2HTML_SINK_ERROR;
+    }
+    catch (...)
+    {
+        return MD2HTML_SINK_ERROR;
+    }
+}
+
+extern "C" MD2HTML_API md2html_status md2html_render_to_buffer(const char *markdown, size_t length,
+                                                               md2html_buffer *buffer, const md2html_options *options)
+{
+    if (buffer == nullptr)
+        return MD2HTML_INVALID_ARGUMENT;
+    OutputBuffer out;
+    md2html_status status = renderLibraryPage(markdown, length, options, out);
+    if (status != MD2HTML_OK)
+        return status;
+
+    // One reallocation, then the pieces are copied in place
+    size_t needed = buffer->length + out.length() + 1;
+    if (needed > buffer->capacity)
+    {
+        size_t capacity = max(needed, buffer->capacity + buffer->capacity / 2);
+        char *data = static_cast<char *>(realloc(buffer->data, capacity));
+        if (data == nullptr)
+            return MD2HTML_OUT_OF_MEMORY;
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    out.forEach([buffer](string_view segment)
+                {
+                    memcpy(buffer->data + buffer->length, segment.data(), segment.length());
+                    buffer->length += segment.length();
+                    return true; });
+    buffer->data[buffer->length] = '\0';
+    return MD2HTML_OK;
+}
+
+extern "C" MD2HTML_API void md2html_buffer_free(md2html_buffer *buffer)
+{
+    if (buffer == nullptr)
+        return;
+    free(buffer->data);
+    *buffer = md2html_buffer();
+}
+
+extern "C" MD2HTML_API const char *md2html_status_string(md2html_status status)
+{
+    switch (status)
+    {
+    case MD2HTML_OK:
+        return "success";
+    case MD2HTML_INVALID_ARGUMENT:
+        return "invalid argument";
+    case MD2HTML_OUT_OF_MEMORY:
+        return "out of memory";
+    case MD2HTML_SINK_ERROR:
+        return "the output sink failed";
+    case MD2HTML_INTERNAL_ERROR:
+        return "internal error";
+    }
+    return "unknown status";
+}
+
+#ifndef MD2HTML_NO_MAIN
+void printUsage(const char *program)
+{
+    cerr << "Usage: " << program << " [--stream] [--toc-file toc.html] [input.md|-] [output.html|-]\n"
+         << "       " << program << " --batch <dir|manifest> -o <outdir> [-j threads]\n"
+         << "       " << program << " --watch <dir> [-o <outdir>] [--debounce ms]\n"
+         << "       " << program << " --serve <socket> [-j threads]\n"
+         << "  -j threads       worker threads; large single files are split across them too\n"
+         << "  --css external   write md2html.css and md2html.js once and link them (default: inline)\n"
+         << "  --minify         minify the page template, stylesheet and script\n"
+         << "  --assets cdn|local|inline\n"
+         << "                   load Highlight.js and MathJax from their CDNs (default), or use the copies in\n"
+         << "                   --vendor-dir, linked from a vendor/ directory beside the pages or inlined\n"
+         << "  --vendor-dir dir highlight.min.css, highlight.min.js and tex-mml-chtml.js for --assets\n"
+         << "  --cache dir      reuse pages converted earlier from identical input\n"
+         << "  --search-index out.json|out.bin\n"
+         << "                   write an inverted index of the pages' words by heading, for client-side search\n"
+         << "  --cache-size MB  evict least recently used pages above this size (default 1024)\n"
+         << "  --max-line-length N, --max-nesting N, --max-table-columns N, --max-footnotes N\n"
+         << "                   limits for untrusted input; past them markup is kept as plain text\n"
+         << "  --profile        report time per stage and counts per block and inline type\n"
+         << "  --profile-json   the same report as JSON\n"
+         << "  --alloc-stats    add heap allocations, bytes and peak live bytes per stage to the profile\n";
+}
+
+int main(int argc, char *argv[])
+{
+    string inputFile = "input.md";
+    string outputFile = "output.html";
+    string tocFile;
+    string batchSource;
+    string batchOutput;
+    string watchDir;
+    string servePath;
+    string cacheDir;
+    string indexPath;
+    uintmax_t cacheMegabytes = 1024;
+    int debounceMs = 5;
+    unsigned threads = 0;
+    ConverterLimits limits;
+    PageOptions pageOptions;
+    bool stream = false;
+    bool profiling = false;
+    bool profileJson = false;
+    bool allocationStats = false;
+
+    // Command line arguments; "-" stands for stdin/stdout
+    vector<string> positional;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--stream")
+            stream = true;
+        else if (arg == "--profile" || arg == "--profile-json")
+        {
+            profiling = true;
+            profileJson = profileJson || arg == "--profile-json";
+        }
+        else if (arg == "--alloc-stats")
+            profiling = allocationStats = true;
+        else if (arg == "--toc-file" && i + 1 < argc)
+            tocFile = argv[++i];
+        else if (arg == "--batch" && i + 1 < argc)
+            batchSource = argv[++i];
+        else if (arg == "--watch" && i + 1 < argc)
+            watchDir = argv[++i];
+        else if (arg == "--serve" && i + 1 < argc)
+            servePath = argv[++i];
+        else if (arg == "--debounce" && i + 1 < argc)
+            debounceMs = max(0, atoi(argv[++i]));
+        else if (arg == "--css" && i + 1 < argc)
+        {
+            string mode = argv[++i];
+            if (mode != "inline" && mode != "external")
+            {
+                cerr << "Error: --css takes 'inline' or 'external', not '" << mode << "'.\n";
+                return 1;
+            }
+            pageOptions.externalAssets = mode == "external";
+        }
+        else if (arg == "--minify")
+            pageOptions.minify = true;
+        else if (arg == "--assets" && i + 1 < argc)
+        {
+            string source = argv[++i];
+            if (source != "cdn" && source != "local" && source != "inline")
+            {
+                cerr << "Error: --assets takes 'cdn', 'local' or 'inline', not '" << source << "'.\n";
+                return 1;
+            }
+            pageOptions.vendor = source == "cdn" ? AssetSource::Cdn : (source == "local" ? AssetSource::Local : AssetSource::Inline);
+        }
+        else if (arg == "--vendor-dir" && i + 1 < argc)
+            pageOptions.vendorDirectory = argv[++i];
+        else if (arg == "--cache" && i + 1 < argc)
+            cacheDir = argv[++i];
+        else if (arg == "--search-index" && i + 1 < argc)
+            indexPath = argv[++i];
+        else if (arg == "--cache-size" && i + 1 < argc)
+            cacheMegabytes = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--max-line-length" && i + 1 < argc)
+            limits.maxLineLength = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--max-nesting" && i + 1 < argc)
+            limits.maxNesting = max(1, atoi(argv[++i]));
+        else if (arg == "--max-table-columns" && i + 1 < argc)
+            limits.maxTableColumns = max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--max-footnotes" && i + 1 < argc)
+            limits.maxFootnotes = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "-o" && i + 1 < argc)
+            batchOutput = argv[++i];
+        else if (arg == "-j" && i + 1 < argc)
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        else if (arg.length() > 1 && arg[0] == '-')
+        {
+            cerr << "Error: Unknown option '" << arg << "'.\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        else
+            positional.push_back(arg);
+    }
+
+    if (!loadVendorAssets(pageOptions))
+        return 1;
+
+    // Everything besides the input that shapes a page goes into its cache key
+    string vendored = pageOptions.vendor == AssetSource::Cdn ? "cdn" : (pageOptions.vendor == AssetSource::Local ? "local" : "inline");
+    for (size_t i = 0; pageOptions.vendored && i < pageOptions.vendored->size(); i++)
+    {
+        uint64_t hash[2];
+        hashBytes((*pageOptions.vendored)[i], 0, hash);
+        vendored += "," + to_string(hash[0]);
+    }
+    const string cacheOptions = "title=Markdown Document;limits=" + to_string(limits.maxLineLength) + "," +
+                                to_string(limits.maxNesting) + "," + to_string(limits.maxTableColumns) + "," +
+                                to_string(limits.maxFootnotes) + ";css=" +
+                                (pageOptions.externalAssets ? "external" : "inline") + ";minify=" +
+                                (pageOptions.minify ? "1" : "0") + ";assets=" + vendored;
+    unique_ptr<ConversionCache> cache;
+    if (!cacheDir.empty())
+    {
+        cache = make_unique<ConversionCache>(cacheDir, cacheMegabytes << 20);
+        if (!cache->isOpen())
+        {
+            cerr << "Error: Cannot create cache directory '" << cacheDir << "'.\n";
+            return 1;
+        }
+    }
+
+    if (profiling && (!batchSource.empty() || !watchDir.empty() || !servePath.empty()))
+    {
+        cerr << "Error: --profile and --alloc-stats work on a single input file.\n";
+        return 1;
+    }
+
+    if (!indexPath.empty() && (!watchDir.empty() || !servePath.empty()))
+    {
+        cerr << "Error: --search-index works on a single input file or a --batch run.\n";
+        return 1;
+    }
+
+    // Pages served link any external assets by the bare file name
+    if (!servePath.empty())
+        return runServe(servePath, threads, limits, pageOptions);
+
+    if (!batchSource.empty())
+    {
+        if (batchOutput.empty() || !positional.empty())
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        pageOptions.assetDirectory = batchOutput;
+        return runBatch(batchSource, batchOutput, threads, limits, pageOptions, cache.get(), cacheOptions, indexPath);
+    }
+
+    // Without -o, pages are written next to their sources
+    if (!watchDir.empty())
+    {
+        pageOptions.assetDirectory = batchOutput.empty() ? watchDir : batchOutput;
+        return runWatch(watchDir, pageOptions.assetDirectory.string(), debounceMs, limits, pageOptions);
+    }
+
+    if (positional.size() >= 1)
+        inputFile = positional[0];
+    if (positional.size() >= 2)
+        outputFile = positional[1];
+    if (inputFile == "-" || outputFile == "-" || !tocFile.empty())
+        stream = true;
+
+    // Check if input file exists
+    if (inputFile != "-" && !fileExists(inputFile))
+    {
+        cerr << "Error: Input file '" << inputFile << "' not found.\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    ifstream inFile;
+    ofstream outFile;
+    if (stream && inputFile != "-")
+    {
+        inFile.open(inputFile);
+        if (!inFile.is_open())
+        {
+            cerr << "Error: Cannot open input file '" << inputFile << "'.\n";
+            return 1;
+        }
+    }
+    if (stream && outputFile != "-")
+    {
+        outFile.open(outputFile);
+        if (!outFile.is_open())
+        {
+            cerr << "Error: Cannot create output file '" << outputFile << "'.\n";
+            return 1;
+        }
+    }
+
+    // A single page links assets written next to it
+    pageOptions.assetDirectory = outputFile == "-" ? fs::path(".") : fs::path(outputFile).parent_path();
+    if (pageOptions.assetDirectory.empty())
+        pageOptions.assetDirectory = ".";
+    if (!writePageAssets(pageOptions))
+        return 1;
+
+    MarkdownConverter converter;
+    converter.setThreads(threads != 0 ? threads : thread::hardware_concurrency());
+    converter.setLimits(limits);
+    size_t inputLength = 0;
+
+    // Profiled runs convert on one thread, always, so the stages add up
+    Profile profile;
+    Profile *activeProfile = profiling ? &profile : nullptr;
+    if (profiling)
+    {
+        converter.setThreads(1);
+        converter.setProfile(activeProfile);
+        cache.reset();
+        if (allocationStats)
+            profile.countAllocations();
+    }
+    auto reportProfile = [&](ostream &out)
+    {
+        profile.enter(Stage::Other);
+        if (profileJson)
+            profile.reportJson(out, inputFile, inputLength);
+        else
+            profile.report(out, inputFile, inputLength);
+    };
+
+    SearchIndex index;
+    SearchIndex *activeIndex = indexPath.empty() ? nullptr : &index;
+    if (activeIndex != nullptr)
+        index.beginDocument(outputFile == "-" ? string() : searchIndexUrl(outputFile, indexPath));
+    auto writeIndex = [&]
+    {
+        StageTimer timer(activeProfile, Stage::Write);
+        if (activeIndex == nullptr || index.write(indexPath))
+            return true;
+        cerr << "Error: Cannot write search index '" << indexPath << "'.\n";
+        return false;
+    };
+
+    if (stream)
+    {
+        // Streaming: HTML is written as blocks complete, so memory stays
+        // bounded by the largest block rather than the whole document
+        ios::sync_with_stdio(false);
+        istream &in = inputFile == "-" ? cin : inFile;
+        ostream &out = outputFile == "-" ? cout : outFile;
+
+        ofstream tocOut;
+        if (!tocFile.empty())
+        {
+            tocOut.open(tocFile);
+            if (!tocOut.is_open())
+            {
+                cerr << "Error: Cannot create TOC file '" << tocFile << "'.\n";
+                return 1;
+            }
+        }
+
+        {
+            StageTimer timer(activeProfile, Stage::Template);
+            out << htmlHeader("Markdown Document", pageOptions);
+        }
+        unsigned features = 0;
+        inputLength = converter.convertStream(in, out, tocFile.empty() ? nullptr : &tocOut, &features, activeIndex);
+        {
+            StageTimer timer(activeProfile, Stage::Template);
+            out << htmlFooter(pageOptions, features);
+        }
+        {
+            StageTimer timer(activeProfile, Stage::Write);
+            out.flush();
+        }
+        if (!writeIndex())
+            return 1;
+
+        // Stay quiet when the HTML itself goes to stdout
+        if (outputFile == "-")
+        {
+            if (profiling)
+                reportProfile(cerr);
+            return out.good() ? 0 : 1;
+        }
+    }
+    else
+    {
+        // Map the input; lines are parsed as views into the mapping
+        MappedFile input = [&]
+        {
+            StageTimer timer(activeProfile, Stage::Read);
+            return MappedFile(inputFile);
+        }();
+        if (!input.isOpen())
+        {
+            cerr << "Error: Cannot open input file '" << inputFile << "'.\n";
+            return 1;
+        }
+        string_view markdown = input.view();
+        inputLength = markdown.length();
+
+        string key = cache ? ConversionCache::key(markdown, cacheOptions) : string();
+        if (cache && cache->fetch(key, outputFile))
+        {
+            if (activeIndex != nullptr)
+                converter.indexDocument(markdown, index);
+        }
+        else
+        {
+            // Convert markdown to HTML inside the page template; the pieces are
+            // written out together without being joined first
+            OutputBuffer page;
+            {
+                StageTimer timer(activeProfile, Stage::Template);
+                appendHtmlHeader(page, "Markdown Document", pageOptions);
+            }
+            unsigned features = 0;
+            converter.convertToHTML(markdown, page, &features, activeIndex);
+            {
+                StageTimer timer(activeProfile, Stage::Template);
+                appendHtmlFooter(page, pageOptions, features);
+            }
+
+            StageTimer writeTimer(activeProfile, Stage::Write);
+            if (!page.writeFile(outputFile))
+            {
+                cerr << "Error: Cannot write output file '" << outputFile << "'.\n";
+                return 1;
+            }
+            if (cache)
+            {
+                cache->store(key, page);
+                cache->trimIfDue(page.length());
+            }
+        }
+        if (!writeIndex())
+            return 1;
+    }
+
+    if (profileJson)
+    {
+        reportProfile(cout);
+        return 0;
+    }
+
+    cout << "Conversion complete!\n";
+    cout << "  Input:  " << inputFile << " (" << inputLength << " characters)\n";
+    if (cache && !stream)
+        cache->printStats(cout);
+    cout << "  Output: " << outputFile << "\n";
+    if (activeIndex != nullptr)
+        cout << "  Index:  " << indexPath << " (" << index.sectionCount() << " sections, " << index.termCount() << " terms)\n";
+    if (profiling)
+        reportProfile(cout);
+
+    inFile.close();
+    outFile.close();
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,94 @@
+// md2html library API
+//
+// The converter in main.cpp, callable from C and C++. Build it with the
+// command-line tool's main() left out:
+//
+//   g++ -std=c++17 -O2 -pthread -fPIC -fvisibility=hidden -DMD2HTML_NO_MAIN -shared -o libmd2html.so main.cpp
+//
+// The page is rendered in full, then handed over in the pieces it was built
+// from, without joining them first, either to a callback or to a buffer that
+// grows as needed. Errors come back as status codes; nothing is thrown across
+// the API and nothing is printed. Every function may be called from any
+// number of threads at once.
+
+#ifndef MD2HTML_H
+#define MD2HTML_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define MD2HTML_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define MD2HTML_API __attribute__((visibility("default")))
+#else
+#define MD2HTML_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum md2html_status
+{
+    MD2HTML_OK = 0,
+    MD2HTML_INVALID_ARGUMENT, // A required pointer was null
+    MD2HTML_OUT_OF_MEMORY,
+    MD2HTML_SINK_ERROR,       // The sink's write returned non-zero
+    MD2HTML_INTERNAL_ERROR
+} md2html_status;
+
+// Receives the output in order. write returns 0 to go on, or anything else
+// to stop the render, which then returns MD2HTML_SINK_ERROR. data is only
+// valid during the call.
+typedef struct md2html_sink
+{
+    int (*write)(void *user, const char *data, size_t length);
+    void *user;
+} md2html_sink;
+
+// Fill with md2html_options_init() and change what is needed; a null
+// options pointer means the defaults. Zero limits mean the default limit.
+typedef struct md2html_options
+{
+    int fragment;             // Non-zero: TOC, body and footnotes only, without the page template
+    int minify;               // Minified page template, stylesheet and script
+    int external_css;         // Link md2html.css and md2html.js instead of inlining them
+    const char *asset_path;   // URL prefix for those, "" or ending in '/'; null means ""
+    const char *title;        // Page title; null means "Markdown Document"
+    size_t max_line_length;   // Limits for untrusted input, as the --max-* options
+    size_t max_nesting;
+    size_t max_table_columns;
+    size_t max_footnotes;
+} md2html_options;
+
+// A growable output buffer. data is null or comes from malloc; the render
+// appends to it, reallocating as needed, and keeps it NUL-terminated
+// (the terminator is not counted in length). Release with md2html_buffer_free.
+typedef struct md2html_buffer
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+} md2html_buffer;
+
+MD2HTML_API void md2html_options_init(md2html_options *options);
+
+// Converts length bytes of markdown and writes the HTML to sink.
+MD2HTML_API md2html_status md2html_render(const char *markdown, size_t length, md2html_sink *sink,
+                                          const md2html_options *options);
+
+// The same, appending the HTML to buffer. On failure buffer keeps what it
+// held before the call.
+MD2HTML_API md2html_status md2html_render_to_buffer(const char *markdown, size_t length, md2html_buffer *buffer,
+                                                    const md2html_options *options);
+
+MD2HTML_API void md2html_buffer_free(md2html_buffer *buffer);
+
+// A short English description of status
+MD2HTML_API const char *md2html_status_string(md2html_status status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif